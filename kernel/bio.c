@@ -23,6 +23,8 @@
 #include "fs.h"
 #include "buf.h"
 
+#define PREFETCH_MAX 6  // blocks per prefetch request (virtio NUM-2)
+
 struct {
   struct spinlock lock;
   struct buf buf[NBUF];
@@ -88,6 +90,63 @@ bget(uint dev, uint blockno)
   panic("bget: no buffers");
 }
 
+// Like bget, but only for a block that is not cached, and
+// without waiting: returns 0 if the block is cached or no buffer
+// is free. A recycled buffer is unused, so locking it can't block.
+static struct buf*
+bgetnew(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  acquire(&bcache.lock);
+  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+    if(b->dev == dev && b->blockno == blockno){
+      release(&bcache.lock);
+      return 0;
+    }
+  }
+  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
+    if(b->refcnt == 0) {
+      b->dev = dev;
+      b->blockno = blockno;
+      b->valid = 0;
+      b->refcnt = 1;
+      release(&bcache.lock);
+      acquiresleep(&b->lock);
+      return b;
+    }
+  }
+  release(&bcache.lock);
+  return 0;
+}
+
+// Read the n blocks in blocknos into the cache ahead of use.
+// Runs of consecutive blocks that are not cached go to the disk
+// as one request of up to PREFETCH_MAX blocks. Blocks that are
+// already cached are left alone.
+void
+bprefetch(uint dev, uint *blocknos, int n)
+{
+  struct buf *run[PREFETCH_MAX];
+  struct buf *b;
+  int nrun = 0;
+
+  for(int i = 0; i <= n; i++){
+    b = i < n ? bgetnew(dev, blocknos[i]) : 0;
+    if(nrun > 0 && (b == 0 || nrun == PREFETCH_MAX ||
+                    b->blockno != run[nrun-1]->blockno + 1)){
+      virtio_disk_readbufs(run, nrun);
+      for(int j = 0; j < nrun; j++){
+        run[j]->valid = 1;
+        brelse(run[j]);
+      }
+      nrun = 0;
+    }
+    if(b)
+      run[nrun++] = b;
+  }
+}
+
 // Return a locked buf with the contents of the indicated block.
 struct buf*
 bread(uint dev, uint blockno)
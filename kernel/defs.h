@@ -2,17 +2,23 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct page_info;
+struct pagingstat;
+struct pcache_stat;
 struct pipe;
 struct proc;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct vmstat;
+struct zswap_stat;
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
 void            brelse(struct buf*);
+void            bprefetch(uint, uint*, int);
 void            bwrite(struct buf*);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
@@ -50,6 +56,7 @@ int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, int, uint64, uint, uint);
+void            iprefetch(struct inode*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
 void            itrunc(struct inode*);
@@ -58,15 +65,47 @@ struct inode*   create(char*, short, short, short);
 
 // kalloc.c
 void*           kalloc(void);
+void*           kalloc_mega(void);
 void            kfree(void *);
+int             kfreecount(void);
+void            kref(void *);
+int             krefcount(void *);
 void            kinit(void);
 
+// mmap.c
+struct mmap_region;
+uint64          mmap_floor(struct proc*);
+struct mmap_region* mmap_find(struct proc*, uint64);
+int             mmap_readpage(struct mmap_region*, uint64, uint64);
+void            mmap_writepage(struct mmap_region*, uint64, uint64);
+uint64          mmap(struct file*, uint64, int, int, uint);
+int             munmap(uint64, uint64);
+void            munmap_all(struct proc*);
+int             mmap_fork(struct proc*, struct proc*);
+
 // log.c
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
 void            begin_op(void);
 void            end_op(void);
 
+// pcache.c
+void            pcacheinit(void);
+uint64          pcache_get(uint, uint, uint, uint);
+uint64          pcache_add(uint, uint, uint, uint, uint64);
+int             pcache_shrink(int);
+void            pcache_invalidate(uint, uint);
+void            pcache_getstat(struct pcache_stat*);
+
+// zswap.c
+void            zswapinit(void);
+int             zswap_store(int, uint64);
+int             zswap_load(int, uint64);
+void            zswap_drop(int);
+int             zswap_shrink(void);
+void            zswap_getstat(struct zswap_stat*);
+extern int      zswap;
+
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
@@ -89,6 +128,7 @@ void            proc_freepagetable(pagetable_t, uint64);
 int             kkill(int);
 int             killed(struct proc*);
 void            setkilled(struct proc*);
+int             proc_pagingstat(int, struct pagingstat*);
 struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            procinit(void);
@@ -96,6 +136,7 @@ void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
+struct proc*    kthread(char*, void (*)(void));
 int             kwait(uint64);
 void            wakeup(void*);
 void            yield(void);
@@ -116,6 +157,7 @@ void            pop_off(void);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
+int             tryacquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
@@ -144,6 +186,12 @@ void            trapinithart(void);
 extern struct spinlock tickslock;
 void            prepare_return(void);
 
+// trace.c
+void            traceinit(void);
+void            trace(int, int, uint64, int, int);
+int             traceread(uint64, int);
+extern int      traceconsole;
+
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
@@ -154,12 +202,18 @@ int             uartgetc(void);
 // vm.c
 void            kvminit(void);
 void            kvminithart(void);
+void            pageinit(void);
+void            pageoutinit(void);
+int             pageout_setwmark(int, int);
+int             pageout_lowmem(void);
+void            vmstat(struct vmstat*);
 void            kvmmap(pagetable_t, uint64, uint64, uint64, int);
 int             mappages(pagetable_t, uint64, uint64, uint64, int);
 pagetable_t     uvmcreate(void);
 uint64          uvmalloc(pagetable_t, uint64, uint64, int);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
+int             uvmshare(pagetable_t, pagetable_t, uint64, uint64, int);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
@@ -170,16 +224,33 @@ int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
 int             ismapped(pagetable_t, uint64);
 uint64          vmfault(pagetable_t, uint64, uint64);
-int             create_swapfile(struct proc*);
-void            delete_swapfile(struct proc*);
-int             swapout_page(struct proc*, uint64);
+void            swapinit(void);
+void            release_swap(struct proc*);
 int             swapin_page(struct proc*, uint64);
-int             alloc_swap_slot(struct proc*);
-void            free_swap_slot(struct proc*, int);
+int             alloc_swap_slot(void);
+void            free_swap_slot(int);
+int             swap_hold(int);
+void            swap_writeslot(int, uint64);
 struct page_info* find_page_info(struct proc*, uint64);
+struct page_info* page_info_first(struct proc*);
+struct page_info* page_info_next(struct page_info*);
 struct page_info* add_page_info(struct proc*, uint64);
-uint64          evict_page(struct proc*);
+void            remove_page_info(struct proc*, struct page_info*);
+void            clear_page_info(struct proc*);
+void            drop_page_info(struct proc*);
+int             unmap_range(struct proc*, uint64, uint64);
+int             copy_page_info(struct proc*, struct proc*);
+int             evict_page(struct proc*);
+extern int      pagescope;
+extern int      swapcluster;
+extern int      faultaround;
+extern int      megapages;
 void            mark_page_dirty(struct proc*, uint64);
+int             page_is_dirty(struct proc*, struct page_info*);
+int             madvise(uint64, uint64, int);
+int             pagingstat(int, struct pagingstat*);
+int             rsslimit(int);
+void            wss_sample(struct proc*);
 
 // plic.c
 void            plicinit(void);
@@ -191,6 +262,9 @@ void            plic_complete(int);
 void            virtio_disk_init(void);
 void            virtio_disk_rw(struct buf *, int);
 void            virtio_disk_intr(void);
+uint64          virtio_disk_capacity(void);
+void            virtio_disk_rwpages(uint, uint64*, int, int);
+void            virtio_disk_readbufs(struct buf**, int);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
@@ -3,13 +3,14 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "defs.h"
 #include "elf.h"
 #include "fs.h"
-#include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "vm.h"
 
 // map ELF permissions to PTE permission bits.
 int flags2perm(int flags)
@@ -29,11 +30,12 @@ int
 kexec(char *path, char **argv)
 {
   char *s, *last;
-  int i, off;
+  int i, off, nsegments = 0;
   uint64 argc, sz = 0, sp, ustack[MAXARG], stackbase;
   struct elfhdr elf;
-  struct inode *ip;
+  struct inode *ip, *exec_inode = 0;
   struct proghdr ph;
+  struct prog_segment segments[8];
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
   struct inode *old_exec_inode;
@@ -58,11 +60,10 @@ kexec(char *path, char **argv)
   if((pagetable = proc_pagetable(p)) == 0)
     goto bad;
 
-  // Initialize demand paging metadata
-  p->nsegments = 0;
-  p->npages = 0;
-  p->next_seq = 0;
-  
+  // The new image is built aside and p's demand paging state is
+  // replaced only once nothing can fail, so that a failed exec
+  // leaves the caller's pages, swapped ones included, intact.
+
   // Save program segments for demand loading (DO NOT load them now)
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, 0, (uint64)&ph, off, sizeof(ph)) != sizeof(ph))
@@ -77,14 +78,14 @@ kexec(char *path, char **argv)
       goto bad;
     
     // Store segment info for demand loading
-    if(p->nsegments >= 8)
+    if(nsegments >= 8)
       goto bad;
-    p->segments[p->nsegments].vaddr = ph.vaddr;
-    p->segments[p->nsegments].filesz = ph.filesz;
-    p->segments[p->nsegments].memsz = ph.memsz;
-    p->segments[p->nsegments].off = ph.off;
-    p->segments[p->nsegments].perm = flags2perm(ph.flags);
-    p->nsegments++;
+    segments[nsegments].vaddr = ph.vaddr;
+    segments[nsegments].filesz = ph.filesz;
+    segments[nsegments].memsz = ph.memsz;
+    segments[nsegments].off = ph.off;
+    segments[nsegments].perm = flags2perm(ph.flags);
+    nsegments++;
     
     // Update sz to track the memory size (but don't allocate)
     if(ph.vaddr + ph.memsz > sz)
@@ -95,19 +96,19 @@ kexec(char *path, char **argv)
   uint64 text_start = 0, text_end = 0, data_start = 0, data_end = 0;
   
   // Find text segment (executable, not writable)
-  for(int i = 0; i < p->nsegments; i++) {
-    if(p->segments[i].perm & PTE_X) {
-      text_start = p->segments[i].vaddr;
-      text_end = p->segments[i].vaddr + p->segments[i].memsz;
+  for(int i = 0; i < nsegments; i++) {
+    if(segments[i].perm & PTE_X) {
+      text_start = segments[i].vaddr;
+      text_end = segments[i].vaddr + segments[i].memsz;
       break;
     }
   }
   
   // Find data segment (writable, not executable)
-  for(int i = 0; i < p->nsegments; i++) {
-    if((p->segments[i].perm & PTE_W) && !(p->segments[i].perm & PTE_X)) {
-      data_start = p->segments[i].vaddr;
-      data_end = p->segments[i].vaddr + p->segments[i].memsz;
+  for(int i = 0; i < nsegments; i++) {
+    if((segments[i].perm & PTE_W) && !(segments[i].perm & PTE_X)) {
+      data_start = segments[i].vaddr;
+      data_end = segments[i].vaddr + segments[i].memsz;
       break;
     }
   }
@@ -116,16 +117,16 @@ kexec(char *path, char **argv)
   uint64 heap_start_addr = sz;
   uint64 stack_top = sz + USERSTACK*PGSIZE + PGSIZE; // +PGSIZE for guard page
   
-  printf("[pid %d] INIT-LAZYMAP text=[0x%lx,0x%lx) data=[0x%lx,0x%lx) heap_start=0x%lx stack_top=0x%lx\n",
-         p->pid,
-         text_start, text_end,
-         data_start, data_end,
-         heap_start_addr,
-         stack_top);
+  if(traceconsole)
+    printf("[pid %d] INIT-LAZYMAP text=[0x%lx,0x%lx) data=[0x%lx,0x%lx) heap_start=0x%lx stack_top=0x%lx\n",
+           p->pid,
+           text_start, text_end,
+           data_start, data_end,
+           heap_start_addr,
+           stack_top);
 
   // Keep the executable inode open for demand loading  
-  old_exec_inode = p->exec_inode;
-  p->exec_inode = idup(ip);
+  exec_inode = idup(ip);
   
   iunlockput(ip);
   end_op();
@@ -136,7 +137,7 @@ kexec(char *path, char **argv)
 
   // Setup stack region
   sz = PGROUNDUP(sz);
-  p->heap_start = sz;  // Heap starts after text/data
+  uint64 heap_start = sz;  // Heap starts after text/data
   
   // Reserve space for stack
   // Make the first inaccessible as a stack guard.
@@ -152,8 +153,6 @@ kexec(char *path, char **argv)
   
   sp = sz;
   stackbase = sp - USERSTACK*PGSIZE;
-  p->stack_bottom = stackbase;
-  p->stack_top = sz;  // Save original stack top for lazy allocation boundary
   
   // Allocate the initial stack page for arguments
   // This is needed because copyout happens before trapframe->sp is set
@@ -165,18 +164,6 @@ kexec(char *path, char **argv)
     kfree(stack_mem);
     goto bad;
   }
-  
-  // Add initial stack page to tracking
-  if(p->npages < MAX_SWAP_PAGES) {
-    struct page_info *pi = &p->pages[p->npages];
-    pi->va = PGROUNDDOWN(stackbase);
-    pi->seq = p->next_seq++;
-    pi->dirty = 0;
-    pi->swapped = 0;
-    pi->swap_offset = 0;
-    pi->resident = 1;
-    p->npages++;
-  }
 
   // Copy argument strings into new stack
   for(argc = 0; argv[argc]; argc++) {
@@ -211,20 +198,32 @@ kexec(char *path, char **argv)
       last = s+1;
   safestrcpy(p->name, last, sizeof(p->name));
   
-  // Create swap file for this process
-  // Note: We create it here during exec as per spec, though it may not be used
-  if(create_swapfile(p) < 0) {
-    // Failed to create swap file - not fatal, will be created on first use
-    p->swapfile = 0;
-  }
-    
-  // Commit to the user image.
+  // Commit to the user image. Mapped files go with the old one;
+  // their write-back needs its own log transactions, which is fine
+  // here, past end_op(). Then replace the old image's page metadata
+  // and swap slots with the new one's.
+  munmap_all(p);
+  acquiresleep(&p->vmlock);
+  drop_page_info(p);
+  p->next_seq = 0;
+  p->madv = MADV_NORMAL;
+  memmove(p->segments, segments, sizeof(segments));
+  p->nsegments = nsegments;
+  p->heap_start = heap_start;
+  p->stack_bottom = stackbase;
+  p->stack_top = sz;  // Save original stack top for lazy allocation boundary
+  old_exec_inode = p->exec_inode;
+  p->exec_inode = exec_inode;
+  // Add initial stack page to tracking
+  add_page_info(p, PGROUNDDOWN(stackbase));
+
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = ulib.c:start()
   p->trapframe->sp = sp; // initial stack pointer
   proc_freepagetable(oldpagetable, oldsz);
+  releasesleep(&p->vmlock);
   
   // Clean up old exec inode if any
   if(old_exec_inode) {
@@ -242,5 +241,10 @@ kexec(char *path, char **argv)
     iunlockput(ip);
     end_op();
   }
+  if(exec_inode){
+    begin_op();
+    iput(exec_inode);
+    end_op();
+  }
   return -1;
 }
@@ -15,8 +15,8 @@
 #include "param.h"
 #include "stat.h"
 #include "spinlock.h"
-#include "proc.h"
 #include "sleeplock.h"
+#include "proc.h"
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
@@ -473,6 +473,7 @@ itrunc(struct inode *ip)
 
   ip->size = 0;
   iupdate(ip);
+  pcache_invalidate(ip->dev, ip->inum);
 }
 
 // Copy stat information from inode.
@@ -487,6 +488,30 @@ stati(struct inode *ip, struct stat *st)
   st->size = ip->size;
 }
 
+// Bring the blocks holding bytes [off, off+n) of ip into the
+// buffer cache, reading runs of consecutive blocks together.
+// Caller must hold ip->lock.
+void
+iprefetch(struct inode *ip, uint off, uint n)
+{
+  uint blocknos[PGSIZE / BSIZE];
+  int nb = 0;
+
+  if(off >= ip->size)
+    return;
+  if(off + n > ip->size)
+    n = ip->size - off;
+  for(uint bn = off / BSIZE; bn * BSIZE < off + n; bn++){
+    blocknos[nb++] = bmap(ip, bn);
+    if(nb == NELEM(blocknos)){
+      bprefetch(ip->dev, blocknos, nb);
+      nb = 0;
+    }
+  }
+  if(nb > 0)
+    bprefetch(ip->dev, blocknos, nb);
+}
+
 // Read data from inode.
 // Caller must hold ip->lock.
 // If user_dst==1, then dst is a user virtual address;
@@ -535,6 +560,8 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
     return -1;
   if(off + n > MAXFILE*BSIZE)
     return -1;
+  if(ip->type == T_FILE)
+    pcache_invalidate(ip->dev, ip->inum);
 
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
     uint addr = bmap(ip, off/BSIZE);
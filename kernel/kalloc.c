@@ -18,9 +18,13 @@ struct run {
   struct run *next;
 };
 
+#define PA2REF(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+
 struct {
   struct spinlock lock;
   struct run *freelist;
+  int nfree;               // pages on freelist
+  int ref[PA2REF(PHYSTOP)]; // mappings of each page (copy-on-write)
 } kmem;
 
 void
@@ -39,9 +43,9 @@ freerange(void *pa_start, void *pa_end)
     kfree(p);
 }
 
-// Free the page of physical memory pointed at by pa,
-// which normally should have been returned by a
-// call to kalloc().  (The exception is when
+// Drop a reference to the page of physical memory pointed at by pa,
+// which normally should have been returned by a call to kalloc(),
+// and free it when none are left. (The exception is when
 // initializing the allocator; see kinit above.)
 void
 kfree(void *pa)
@@ -51,14 +55,26 @@ kfree(void *pa)
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
+  acquire(&kmem.lock);
+  if(kmem.ref[PA2REF(pa)] > 1) {
+    kmem.ref[PA2REF(pa)]--;
+    release(&kmem.lock);
+    return;
+  }
+  release(&kmem.lock);
+
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
 
   r = (struct run*)pa;
 
+  // The count drops to zero only once the page is on the freelist,
+  // so kalloc_mega() can trust it.
   acquire(&kmem.lock);
+  kmem.ref[PA2REF(pa)] = 0;
   r->next = kmem.freelist;
   kmem.freelist = r;
+  kmem.nfree++;
   release(&kmem.lock);
 }
 
@@ -72,11 +88,84 @@ kalloc(void)
 
   acquire(&kmem.lock);
   r = kmem.freelist;
-  if(r)
+  if(r) {
     kmem.freelist = r->next;
+    kmem.nfree--;
+    kmem.ref[PA2REF(r)] = 1;
+  }
   release(&kmem.lock);
 
   if(r)
     memset((char*)r, 5, PGSIZE); // fill with junk
   return (void*)r;
 }
+
+// Allocate MEGASIZE bytes of physically contiguous memory, aligned
+// to MEGASIZE, for a megapage mapping. Each of its pages gets one
+// reference, so it can later be split and freed page by page with
+// kfree(). Returns 0 if no such run of free pages exists.
+void *
+kalloc_mega(void)
+{
+  struct run **rp;
+  uint64 base;
+  int i, n = MEGASIZE / PGSIZE;
+
+  acquire(&kmem.lock);
+  for(base = MEGAROUNDUP((uint64)end); base + MEGASIZE <= PHYSTOP; base += MEGASIZE) {
+    for(i = 0; i < n; i++)
+      if(kmem.ref[PA2REF(base + i*PGSIZE)] != 0)
+        break;
+    if(i == n)
+      break;
+  }
+  if(base + MEGASIZE > PHYSTOP) {
+    release(&kmem.lock);
+    return 0;
+  }
+
+  // All n pages are on the freelist; take them off it.
+  for(rp = &kmem.freelist; *rp; ) {
+    if((uint64)*rp >= base && (uint64)*rp < base + MEGASIZE)
+      *rp = (*rp)->next;
+    else
+      rp = &(*rp)->next;
+  }
+  for(i = 0; i < n; i++)
+    kmem.ref[PA2REF(base + i*PGSIZE)] = 1;
+  kmem.nfree -= n;
+  release(&kmem.lock);
+  return (void*)base;
+}
+
+// Number of free pages. Read without the lock, so only a hint.
+int
+kfreecount(void)
+{
+  return kmem.nfree;
+}
+
+// Add a reference to a page returned by kalloc(),
+// for a mapping that shares it.
+void
+kref(void *pa)
+{
+  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+    panic("kref");
+
+  acquire(&kmem.lock);
+  kmem.ref[PA2REF(pa)]++;
+  release(&kmem.lock);
+}
+
+// Number of references to a page; 1 if it is not shared.
+int
+krefcount(void *pa)
+{
+  int n;
+
+  acquire(&kmem.lock);
+  n = kmem.ref[PA2REF(pa)];
+  release(&kmem.lock);
+  return n;
+}
@@ -20,15 +20,20 @@ main()
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
     procinit();      // process table
+    pageinit();      // page replacement lists
     trapinit();      // trap vectors
     trapinithart();  // install kernel trap vector
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
     binit();         // buffer cache
+    pcacheinit();    // executable page cache
+    zswapinit();     // compressed swap cache
+    traceinit();     // paging event trace
     iinit();         // inode table
     fileinit();      // file table
     virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
+    pageoutinit();   // page-out daemon
     __sync_synchronize();
     started = 1;
   } else {
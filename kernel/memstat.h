@@ -9,6 +9,7 @@
 #define UNMAPPED 0 
 #define RESIDENT 1 
 #define SWAPPED  2
+#define ZEROPAGE 3  // reads see the shared zero page, no frame yet
 
 struct page_stat {
   uint va;    
@@ -25,6 +26,102 @@ struct proc_mem_stat {
   int num_swapped_pages;   
   int next_fifo_seq;       
   struct page_stat pages[MAX_PAGES_INFO];
+  int num_zero_pages;      // mapped to the shared zero page
+  int rss;                 // resident pages, all of them
+  int rss_limit;           // resident-set limit (rsslimit), 0 if none
+  int wss;                 // working-set estimate: pages used per WSSTICKS
+};
+
+// Page-out daemon activity
+struct pageout_stat {
+  int low;            // daemon wakes below this many free pages
+  int high;           // ... and reclaims until this many are free
+  int wakeups;        // times the daemon started reclaiming
+  int evicted;        // pages freed by the daemon
+  int stalled;        // runs that stopped short of the high watermark
+  int direct;         // pages freed by faulting processes (MEMFULL)
+};
+
+// Swap area
+struct swap_stat {
+  int slots;          // pages the swap area holds
+  int used;           // slots in use, by all processes
+};
+
+// Swap-in readahead and executable fault-around
+struct ra_stat {
+  int readahead;      // pages swapped in speculatively
+  int hits;           // ... and used before eviction
+  int waste;          // ... and evicted unused
+  int faultaround;    // executable pages loaded around a fault
+};
+
+// Shared executable page cache
+struct pcache_stat {
+  int pages;          // pages in the cache
+  int hits;           // executable faults served from it
+};
+
+// Heap megapages
+struct mega_stat {
+  int mapped;         // megapages mapped at fault time
+  int splits;         // megapages split back into pages
+};
+
+// Compressed swap pool
+struct zswap_stat {
+  int pages;          // pages of the pool
+  int stored;         // swapped pages held there, not on disk
+  int bytes;          // ... their compressed size
+  int hits;           // swap reads served from the pool
+  int misses;         // swap reads from disk
+  int rejects;        // swap writes that went to disk instead
+  int writebacks;     // pages written to disk to shrink the pool
+  int comp_us;        // CPU time spent compressing, microseconds
+  int decomp_us;      // ... and decompressing
+};
+
+// System-wide memory statistics, one struct per subsystem (vmstat)
+struct vmstat {
+  int free_pages;     // currently free physical pages
+  struct pageout_stat pageout;
+  struct swap_stat swap;
+  struct ra_stat ra;
+  struct pcache_stat pcache;
+  struct mega_stat mega;
+  struct zswap_stat zswap;
+};
+
+// Page faults by cause (pagingstat), in the order of the TRC_*
+// fault causes in trace.h
+#define PF_SWAP   0   // page read back from swap
+#define PF_EXEC   1   // program page loaded from the executable
+#define PF_HEAP   2   // zero-filled heap page
+#define PF_STACK  3   // zero-filled stack page
+#define PF_MMAP   4   // page of a mapped file
+#define PF_MINOR  5   // page already mapped: copy-on-write or dirty bit
+#define NPF       6
+
+// Latency histograms (pagingstat)
+#define LAT_FAULT   0   // vmfault(), including waiting for vmlock
+#define LAT_SWAPIN  1   // swapin_page(), readahead included
+#define LAT_SWAPOUT 2   // one swap-out disk request
+#define NLAT        3
+
+// Bucket i counts times of [2^i, 2^(i+1)) time CSR ticks (bucket 0
+// also counts 0); the last one everything longer.
+#define LATBUCKETS  24
+#define LATHZ       10000000  // time CSR ticks per second on qemu virt
+
+// Paging counters and latency histograms of one process, or of the
+// whole system (pagingstat)
+struct pagingstat {
+  uint64 faults[NPF];         // page faults by cause (PF_*)
+  uint64 evicted;             // pages evicted, discards included
+  uint64 discarded;           // clean pages dropped without a write
+  uint64 swapout_bytes;       // bytes written to swap
+  uint64 swapin_bytes;        // bytes read from swap, readahead included
+  uint lat[NLAT][LATBUCKETS]; // log2 latency histograms (LAT_*)
 };
 
 #endif // _MEMSTAT_H_
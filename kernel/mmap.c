@@ -0,0 +1,257 @@
+// Memory-mapped files.
+//
+// mmap() only records a file range in one of the process's region
+// descriptors, placed top-down below the trapframe; the heap may
+// grow up to the lowest region (mmap_floor). Pages are read in by
+// the page fault handler, as program segment pages are from the
+// executable, and are tracked and evicted like any other.
+//
+// A clean page is dropped on eviction and read again later. A
+// written page of a MAP_PRIVATE mapping goes to swap. One of a
+// MAP_SHARED mapping never does: it is written back to the file
+// when its own process evicts it outside a system call, and is
+// not evicted otherwise. Write-back takes the inode lock and a log
+// transaction, which a process faulting in copyin()/copyout(), or
+// the owner of a page evicted by someone else, may already hold.
+//
+// A forked child shares the parent's mapped frames, copy-on-write
+// for private mappings. A shared frame stays resident while more
+// than one process maps it, so that their writes stay visible to
+// each other. Unrelated processes see each other's shared writes
+// only through the file, once written back.
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "fs.h"
+#include "file.h"
+#include "vm.h"
+#include "trace.h"
+
+// Lowest address used by p's mappings.
+uint64
+mmap_floor(struct proc *p)
+{
+  uint64 lo = TRAPFRAME;
+
+  for(int i = 0; i < NMMAP; i++)
+    if(p->mmaps[i].f && p->mmaps[i].vaddr < lo)
+      lo = p->mmaps[i].vaddr;
+  return lo;
+}
+
+// The region of p that maps va, or 0.
+struct mmap_region*
+mmap_find(struct proc *p, uint64 va)
+{
+  struct mmap_region *r;
+
+  for(r = p->mmaps; r < &p->mmaps[NMMAP]; r++)
+    if(r->f && va >= r->vaddr && va < r->vaddr + r->len)
+      return r;
+  return 0;
+}
+
+// Read the page of r at va into frame mem, zero past end of file.
+int
+mmap_readpage(struct mmap_region *r, uint64 va, uint64 mem)
+{
+  struct inode *ip = r->f->ip;
+  uint off = r->off + (va - r->vaddr);
+  // A write() from a mapping of the file being written faults
+  // with its inode locked.
+  int locked = holdingsleep(&ip->lock);
+  int n;
+
+  if(!locked)
+    ilock(ip);
+  iprefetch(ip, off, PGSIZE);
+  n = readi(ip, 0, mem, off, PGSIZE);
+  if(!locked)
+    iunlock(ip);
+  if(n < 0)
+    return -1;
+  memset((char*)mem + n, 0, PGSIZE - n);
+  return 0;
+}
+
+// Write the page of shared mapping r at va, held in frame pa, back
+// to the file, in transactions no larger than filewrite()'s. The
+// file is never extended. The caller must hold no inode lock and
+// must not be inside a file system operation.
+void
+mmap_writepage(struct mmap_region *r, uint64 va, uint64 pa)
+{
+  struct inode *ip = r->f->ip;
+  uint off = r->off + (va - r->vaddr);
+  int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+  int i = 0, n;
+
+  while(i < PGSIZE){
+    n = PGSIZE - i;
+    if(n > max)
+      n = max;
+    begin_op();
+    ilock(ip);
+    if(off + i >= ip->size)
+      n = 0;
+    else if(off + i + n > ip->size)
+      n = ip->size - (off + i);
+    if(n > 0)
+      writei(ip, 0, pa + i, off + i, n);
+    iunlock(ip);
+    end_op();
+    if(n == 0)
+      break;
+    i += n;
+  }
+}
+
+// Map len bytes of f from offset off, which must be page-aligned.
+// Returns the address chosen, or -1.
+uint64
+mmap(struct file *f, uint64 len, int prot, int flags, uint off)
+{
+  struct proc *p = myproc();
+  struct mmap_region *r, *free = 0;
+  uint64 va, lo;
+
+  if(len == 0 || off % PGSIZE != 0 || (prot & PROT_READ) == 0)
+    return -1;
+  if(flags != MAP_SHARED && flags != MAP_PRIVATE)
+    return -1;
+  if(f->type != FD_INODE || !f->readable)
+    return -1;
+  if(flags == MAP_SHARED && (prot & PROT_WRITE) && !f->writable)
+    return -1;
+  len = PGROUNDUP(len);
+
+  acquiresleep(&p->vmlock);
+  for(r = p->mmaps; r < &p->mmaps[NMMAP]; r++)
+    if(r->f == 0)
+      free = r;
+  lo = mmap_floor(p);
+  if(free == 0 || len > lo || lo - len < PGROUNDUP(p->sz)) {
+    releasesleep(&p->vmlock);
+    return -1;
+  }
+  va = lo - len;
+  free->vaddr = va;
+  free->len = len;
+  free->off = off;
+  free->perm = PTE_R;
+  if(prot & PROT_WRITE)
+    free->perm |= PTE_W;
+  if(prot & PROT_EXEC)
+    free->perm |= PTE_X;
+  free->flags = flags;
+  free->f = filedup(f);
+  releasesleep(&p->vmlock);
+  return va;
+}
+
+// Unmap the pages of r in [va, end): write back those of a shared
+// mapping that are newer than the file, then forget them all.
+// The caller holds p->vmlock. Returns -1 if out of memory.
+static int
+mmap_unmap(struct proc *p, struct mmap_region *r, uint64 va, uint64 end)
+{
+  struct page_info *pi;
+  uint64 a;
+
+  for(a = va; r->flags == MAP_SHARED && a < end; a += PGSIZE) {
+    if((pi = find_page_info(p, a)) == 0)
+      continue;
+    if(pi->resident && page_is_dirty(p, pi)) {
+      mmap_writepage(r, a, walkaddr(p->pagetable, a));
+      trace(TR_WRITEBACK, p->pid, a, 0, 0);
+    }
+  }
+  return unmap_range(p, va, end);
+}
+
+// Unmap [va, va+len) of the current process. It must lie in one
+// region and include either its start or its end.
+int
+munmap(uint64 va, uint64 len)
+{
+  struct proc *p = myproc();
+  struct mmap_region *r;
+  struct file *f = 0;
+  uint64 end;
+
+  if(va % PGSIZE != 0 || len == 0)
+    return -1;
+  end = va + PGROUNDUP(len);
+
+  acquiresleep(&p->vmlock);
+  if((r = mmap_find(p, va)) == 0 || end > r->vaddr + r->len ||
+     (va != r->vaddr && end != r->vaddr + r->len)) {
+    releasesleep(&p->vmlock);
+    return -1;
+  }
+  if(mmap_unmap(p, r, va, end) < 0) {
+    releasesleep(&p->vmlock);
+    return -1;
+  }
+  if(va == r->vaddr) {
+    r->vaddr = end;
+    r->off += end - va;
+  }
+  r->len -= end - va;
+  if(r->len == 0) {
+    f = r->f;
+    r->f = 0;
+  }
+  releasesleep(&p->vmlock);
+
+  if(f)
+    fileclose(f);
+  return 0;
+}
+
+// Unmap all of p's regions, at exit() or exec().
+void
+munmap_all(struct proc *p)
+{
+  struct file *f;
+
+  for(int i = 0; i < NMMAP; i++) {
+    struct mmap_region *r = &p->mmaps[i];
+    if(r->f == 0)
+      continue;
+    acquiresleep(&p->vmlock);
+    mmap_unmap(p, r, r->vaddr, r->vaddr + r->len);
+    f = r->f;
+    r->f = 0;
+    releasesleep(&p->vmlock);
+    fileclose(f);
+  }
+}
+
+// Give child np the parent p's regions, sharing their resident
+// frames: copy-on-write for private mappings, writable as before
+// for shared ones. The caller holds p->vmlock and np->lock.
+// Returns -1 if out of memory, with nothing duplicated.
+int
+mmap_fork(struct proc *np, struct proc *p)
+{
+  struct mmap_region *r;
+
+  for(r = p->mmaps; r < &p->mmaps[NMMAP]; r++) {
+    if(r->f && uvmshare(p->pagetable, np->pagetable, r->vaddr,
+                        r->vaddr + r->len, r->flags == MAP_PRIVATE) < 0)
+      return -1;
+  }
+  for(int i = 0; i < NMMAP; i++) {
+    np->mmaps[i] = p->mmaps[i];
+    if(p->mmaps[i].f)
+      np->mmaps[i].f = filedup(p->mmaps[i].f);
+  }
+  return 0;
+}
@@ -13,3 +13,20 @@
 #define MAXPATH      128   // maximum file path name
 #define USERSTACK    1     // user stack pages
 
+#define PAGEALGO     0     // boot-time page replacement: 0=FIFO, 1=CLOCK
+#define PAGESCOPE    0     // boot-time replacement scope: 0=local, 1=global
+#define PAGEOUT_LOW  16    // page-out daemon wakes below this many free pages
+#define PAGEOUT_HIGH 32    // ... and reclaims until this many are free
+#define SWAPPAGES    4096  // max pages in the swap area after the file system
+#define SWAPCLUSTER  4     // max pages evicted and written per request (<= virtio NUM-2)
+#define SWAPRA_MAX   4     // max swap-in readahead window, in pages (< virtio NUM-2)
+#define ZSWAP        1     // boot-time: 1 keeps compressible swapped pages in RAM
+#define ZSWAPPAGES   1024  // max pages of the compressed swap pool
+#define FAULTAROUND  8     // max pages loaded per executable page fault
+#define PCACHE_SIZE  128   // pages in the shared executable page cache
+#define MADV_BEHIND  8     // MADV_SEQUENTIAL: pages behind a fault made next victim
+#define NMMAP        8     // mmap() regions per process
+#define MEGAPAGES    1     // boot-time: 1 maps large lazy heap regions with 2MB megapages
+#define WSSTICKS     5     // ticks between working-set samples of a running process
+#define TRACESIZE    256   // paging trace records kept per CPU
+#define TRACECONSOLE 0     // boot-time: 1 also prints paging events on the console
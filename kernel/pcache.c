@@ -0,0 +1,168 @@
+// Executable page cache.
+//
+// Frames holding pages of read-only program segments, keyed by
+// the file they come from and the byte range read from it, so that
+// processes running the same program map the same frames instead of
+// each reading the text into a private copy.
+//
+// The cache holds one reference (kref) to each frame and every
+// mapping holds another. A frame with no reference but the cache's
+// is unmapped and can be reclaimed; pcache_shrink() does so in LRU
+// order, before page replacement evicts anything mapped.
+//
+// Entries are dropped when their file is written or truncated
+// (pcache_invalidate), since the inode number may be reused.
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "memstat.h"
+
+struct pcentry {
+  uint dev;
+  uint inum;
+  uint off;        // file offset of the page
+  uint len;        // bytes read from the file, the rest is zero
+  uint64 pa;       // frame, 0 if the entry is free
+  uint64 used;     // pcache.clock when last looked up
+};
+
+struct {
+  struct spinlock lock;
+  struct pcentry e[PCACHE_SIZE];
+  uint64 clock;
+  int npages;
+  int hits;
+} pcache;
+
+void
+pcacheinit(void)
+{
+  initlock(&pcache.lock, "pcache");
+}
+
+static struct pcentry*
+pcache_find(uint dev, uint inum, uint off, uint len)
+{
+  for(struct pcentry *e = pcache.e; e < &pcache.e[PCACHE_SIZE]; e++)
+    if(e->pa && e->dev == dev && e->inum == inum && e->off == off && e->len == len)
+      return e;
+  return 0;
+}
+
+static void
+pcache_drop(struct pcentry *e)
+{
+  kfree((void*)e->pa);
+  e->pa = 0;
+  pcache.npages--;
+}
+
+// Look up a cached page. Returns its frame with a reference
+// taken for the caller's mapping, or 0.
+uint64
+pcache_get(uint dev, uint inum, uint off, uint len)
+{
+  struct pcentry *e;
+  uint64 pa = 0;
+
+  acquire(&pcache.lock);
+  if((e = pcache_find(dev, inum, off, len)) != 0) {
+    e->used = ++pcache.clock;
+    pa = e->pa;
+    kref((void*)pa);
+    pcache.hits++;
+  }
+  release(&pcache.lock);
+  return pa;
+}
+
+// Offer a freshly loaded frame to the cache. The caller's reference
+// becomes its mapping's. If another process cached the same page
+// meanwhile, pa is freed and that page is returned instead. If the
+// cache is full of mapped pages, pa simply stays private.
+uint64
+pcache_add(uint dev, uint inum, uint off, uint len, uint64 pa)
+{
+  struct pcentry *e, *victim = 0;
+
+  acquire(&pcache.lock);
+  if((e = pcache_find(dev, inum, off, len)) != 0) {
+    kref((void*)e->pa);
+    kfree((void*)pa);
+    pa = e->pa;
+    e->used = ++pcache.clock;
+    release(&pcache.lock);
+    return pa;
+  }
+
+  // A free entry, or else the least recently used unmapped page.
+  for(e = pcache.e; e < &pcache.e[PCACHE_SIZE]; e++) {
+    if(e->pa == 0) {
+      victim = e;
+      break;
+    }
+    if(krefcount((void*)e->pa) == 1 && (victim == 0 || e->used < victim->used))
+      victim = e;
+  }
+  if(victim) {
+    if(victim->pa)
+      pcache_drop(victim);
+    victim->dev = dev;
+    victim->inum = inum;
+    victim->off = off;
+    victim->len = len;
+    victim->pa = pa;
+    victim->used = ++pcache.clock;
+    kref((void*)pa);
+    pcache.npages++;
+  }
+  release(&pcache.lock);
+  return pa;
+}
+
+// Free up to n cached pages that no process maps, least recently
+// used first. Returns the number freed.
+int
+pcache_shrink(int n)
+{
+  struct pcentry *e, *victim;
+  int freed = 0;
+
+  acquire(&pcache.lock);
+  while(freed < n) {
+    victim = 0;
+    for(e = pcache.e; e < &pcache.e[PCACHE_SIZE]; e++)
+      if(e->pa && krefcount((void*)e->pa) == 1 && (victim == 0 || e->used < victim->used))
+        victim = e;
+    if(victim == 0)
+      break;
+    pcache_drop(victim);
+    freed++;
+  }
+  release(&pcache.lock);
+  return freed;
+}
+
+// Forget every cached page of a file whose contents change.
+// Processes that map them keep their frames.
+void
+pcache_invalidate(uint dev, uint inum)
+{
+  acquire(&pcache.lock);
+  for(struct pcentry *e = pcache.e; e < &pcache.e[PCACHE_SIZE]; e++)
+    if(e->pa && e->dev == dev && e->inum == inum)
+      pcache_drop(e);
+  release(&pcache.lock);
+}
+
+void
+pcache_getstat(struct pcache_stat *st)
+{
+  acquire(&pcache.lock);
+  st->pages = pcache.npages;
+  st->hits = pcache.hits;
+  release(&pcache.lock);
+}
@@ -3,8 +3,10 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "defs.h"
+#include "vm.h"
 
 struct cpu cpus[NCPU];
 
@@ -53,6 +55,7 @@ procinit(void)
   initlock(&wait_lock, "wait_lock");
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
+      initsleeplock(&p->vmlock, "vmlock");
       p->state = UNUSED;
       p->kstack = KSTACK((int) (p - proc));
   }
@@ -143,18 +146,22 @@ found:
   // Initialize demand paging fields
   p->exec_inode = 0;
   p->nsegments = 0;
-  p->npages = 0;
+  clear_page_info(p);
   p->next_seq = 0;
-  p->swapfile = 0;
+  p->pagealgo = PAGEALGO;
+  p->ra_window = 1;
+  p->ra_lo = 0;
+  p->ra_n = 0;
+  p->fsfault = 0;
+  p->incopy = 0;
+  p->madv = MADV_NORMAL;
+  memset(&p->pstat, 0, sizeof(p->pstat));
+  p->rsslimit = 0;
+  p->wss = 0;
+  p->wss_tick = 0;
   p->stack_bottom = 0;
   p->stack_top = 0;
   p->heap_start = 0;
-  
-  // Initialize swap slot bitmap
-  for(int i = 0; i < MAX_SWAP_PAGES / 32; i++) {
-    p->swap_slots[i] = 0;
-  }
-  p->nswap_slots = 0;
 
   // Set up new context to start executing at forkret,
   // which returns to user space.
@@ -186,19 +193,15 @@ freeproc(struct proc *p)
   // The inode will be cleaned up by the file system's normal reference counting
   p->exec_inode = 0;
   
-  // Swap file is already closed in kexit() before locks are acquired
-  // So we just need to clear the pointer
-  p->swapfile = 0;
-  
   p->nsegments = 0;
-  p->npages = 0;
+  clear_page_info(p);
   p->next_seq = 0;
-  p->nswap_slots = 0;
   
   p->sz = 0;
   p->pid = 0;
   p->parent = 0;
   p->name[0] = 0;
+  p->kthread = 0;
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
@@ -266,7 +269,41 @@ userinit(void)
   release(&p->lock);
 }
 
-// Grow or shrink user memory by n bytes.
+// A kernel thread's first scheduling by scheduler()
+// will swtch to kthreadret.
+static void
+kthreadret(void)
+{
+  struct proc *p = myproc();
+
+  // Still holding p->lock from scheduler.
+  release(&p->lock);
+
+  p->kthread();
+  panic("kthread returned");
+}
+
+// Start a process that runs fn() in the kernel and never
+// returns to user space. fn must not return.
+struct proc*
+kthread(char *name, void (*fn)(void))
+{
+  struct proc *p;
+
+  if((p = allocproc()) == 0)
+    panic("kthread");
+  safestrcpy(p->name, name, sizeof(p->name));
+  p->kthread = fn;
+  p->context.ra = (uint64)kthreadret;
+  p->state = RUNNABLE;
+
+  release(&p->lock);
+  return p;
+}
+
+// Grow or shrink user memory by n bytes. Shrinking frees the
+// pages, swap slots, metadata and page-table pages of the range
+// (unmap_range). The caller holds p->vmlock.
 // Return 0 on success, -1 on failure.
 int
 growproc(int n)
@@ -276,14 +313,16 @@ growproc(int n)
 
   sz = p->sz;
   if(n > 0){
-    if(sz + n > TRAPFRAME) {
+    if(sz + n > mmap_floor(p)) {
       return -1;
     }
     if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
       return -1;
     }
-  } else if(n < 0){
-    sz = uvmdealloc(p->pagetable, sz, sz + n);
+  } else if(n < 0 && sz + n < sz){
+    if(unmap_range(p, PGROUNDUP(sz + n), PGROUNDUP(sz)) < 0)
+      return -1;
+    sz += n;
   }
   p->sz = sz;
   return 0;
@@ -298,13 +337,23 @@ kfork(void)
   struct proc *np;
   struct proc *p = myproc();
 
+  // Hold the parent's vmlock across the copy so no other process
+  // steals its pages meanwhile. Taken before allocproc() because
+  // that returns with np->lock held.
+  acquiresleep(&p->vmlock);
+
   // Allocate process.
   if((np = allocproc()) == 0){
+    releasesleep(&p->vmlock);
     return -1;
   }
 
-  // Copy user memory from parent to child.
-  if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+  // Share user memory with the child, copy-on-write.
+  // uvmcopy() write-protects the parent's pages.
+  i = uvmcopy(p->pagetable, np->pagetable, p->sz);
+  sfence_vma();
+  if(i < 0){
+    releasesleep(&p->vmlock);
     freeproc(np);
     release(&np->lock);
     return -1;
@@ -323,15 +372,30 @@ kfork(void)
   np->stack_bottom = p->stack_bottom;
   np->stack_top = p->stack_top;
   
-  // Copy page tracking info
-  for(i = 0; i < p->npages; i++) {
-    np->pages[i] = p->pages[i];
+  // Copy page tracking info. The child shares our swap slots,
+  // so pages swapped out before the fork stay reachable.
+  if(copy_page_info(np, p) < 0){
+    releasesleep(&p->vmlock);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
   }
-  np->npages = p->npages;
-  np->next_seq = p->next_seq;
-  
-  // Note: Swap file not created to avoid locking issues
-  np->swapfile = 0;
+  if(mmap_fork(np, p) < 0){
+    // The child's pages are on the global resident list and hold
+    // references to our swap slots; freeproc() only frees memory.
+    drop_page_info(np);
+    releasesleep(&p->vmlock);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+  sfence_vma();
+  np->pagealgo = p->pagealgo;
+  np->rsslimit = p->rsslimit;
+  np->madv = p->madv;
+  np->madv_lo = p->madv_lo;
+  np->madv_hi = p->madv_hi;
+  releasesleep(&p->vmlock);
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -388,6 +452,9 @@ kexit(int status)
   if(p == initproc)
     panic("init exiting");
 
+  // Write back and close mapped files.
+  munmap_all(p);
+
   // Close all open files.
   for(int fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd]){
@@ -406,8 +473,14 @@ kexit(int status)
   end_op();
   p->cwd = 0;
   
-  // Clean up swap file here (before acquiring locks) to avoid lock ordering issues
-  delete_swapfile(p);
+  // Release our swap slots and take our pages off the global
+  // resident list so no other process tries to evict them once
+  // we are a zombie. Done here (before acquiring locks) to avoid
+  // lock ordering issues.
+  acquiresleep(&p->vmlock);
+  release_swap(p);
+  drop_page_info(p);
+  releasesleep(&p->vmlock);
 
   acquire(&wait_lock);
 
@@ -581,6 +654,7 @@ forkret(void)
     // regular process (e.g., because it calls sleep), and thus cannot
     // be run from main().
     fsinit(ROOTDEV);
+    swapinit();
 
     first = 0;
     // ensure other cores see first=0.
@@ -674,6 +748,25 @@ kkill(int pid)
   return -1;
 }
 
+// Copy the paging counters of process pid to st.
+// Returns -1 if there is no such process.
+int
+proc_pagingstat(int pid, struct pagingstat *st)
+{
+  struct proc *p;
+
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED){
+      *st = p->pstat;
+      release(&p->lock);
+      return 0;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
 void
 setkilled(struct proc *p)
 {
@@ -1,3 +1,5 @@
+#include "memstat.h"
+
 // Saved registers for kernel context switches.
 struct context {
   uint64 ra;
@@ -81,8 +83,8 @@ struct trapframe {
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
-// Maximum pages that can be swapped per process
-#define MAX_SWAP_PAGES 1024
+// Buckets in the per-process VA -> page_info index (power of two)
+#define PAGE_HASH_SIZE 256
 
 // Page metadata for demand paging
 struct page_info {
@@ -90,9 +92,29 @@ struct page_info {
   uint64 seq;             // FIFO sequence number
   int dirty;              // Dirty bit (1 if written)
   int swapped;            // 1 if page is in swap
-  uint swap_offset;       // Offset in swap file (in pages)
+  uint swap_offset;       // Slot in the swap area (in pages)
+  int has_slot;           // 1 if swap_offset is allocated to this page
   int resident;           // 1 if page is in physical memory
+  int used;               // 1 if this slot tracks a page
+  int readahead;          // 1 if swapped in by readahead and not yet used
+  int zero;               // 1 if mapped to the shared zero page, until written
+  int accessed;           // PTE_A seen by wss_sample(), not yet by CLOCK
+  struct proc *owner;     // Process whose address space holds the page
+  struct page_info *hnext; // Next entry in the same page_hash bucket
+  struct page_info *next; // Resident FIFO queue, or free slot list
+  struct page_info *prev; // Resident FIFO queue
+  struct page_info *gnext; // System-wide resident list (global replacement)
+  struct page_info *gprev;
+};
+
+// page_info entries are allocated a page at a time as a process
+// needs them; each such page starts with this header.
+struct page_chunk {
+  struct page_chunk *next; // Next chunk of the same process
+  struct page_chunk *copy; // The child's chunk, during copy_page_info()
+  struct page_info pi[];
 };
+#define PAGE_CHUNK_N ((PGSIZE - sizeof(struct page_chunk)) / sizeof(struct page_info))
 
 // Program segment info for demand loading
 struct prog_segment {
@@ -103,6 +125,17 @@ struct prog_segment {
   int perm;               // Permission bits
 };
 
+// A file range mapped with mmap(), demand-paged from f like a
+// program segment from exec_inode.
+struct mmap_region {
+  uint64 vaddr;           // Virtual address, page-aligned
+  uint64 len;             // Length, page-aligned
+  uint off;               // Offset in file of vaddr
+  int perm;               // Permission bits
+  int flags;              // MAP_SHARED or MAP_PRIVATE
+  struct file *f;         // Mapped file, 0 if the slot is free
+};
+
 // Per-process state
 struct proc {
   struct spinlock lock;
@@ -126,18 +159,38 @@ struct proc {
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  void (*kthread)(void);       // Kernel thread body, or 0 for user processes
   
   // Demand paging fields
+  // vmlock must be held to change page_info, user PTEs or swap state,
+  // since global replacement may evict this process's pages from
+  // another process.
+  struct sleeplock vmlock;
   struct inode *exec_inode;    // Executable inode for demand loading
   struct prog_segment segments[8]; // Program segments (text/data)
   int nsegments;               // Number of segments
   uint64 next_seq;             // Next FIFO sequence number (uint64 wraps after 2^64 allocations)
-  struct page_info pages[MAX_SWAP_PAGES]; // Page metadata
+  struct page_chunk *page_chunks; // Page metadata, grown on demand
   int npages;                  // Number of pages tracked
-  struct file *swapfile;       // Swap file
+  struct page_info *page_hash[PAGE_HASH_SIZE]; // page_info indexed by VPN
+  struct page_info *page_free; // Unused page_info entries
+  struct page_info *fifo_head; // Oldest resident page (next victim)
+  struct page_info *fifo_tail; // Newest resident page
+  int pagealgo;                // Page replacement policy (PAGEALGO_*)
+  int ra_window;               // Swap-in readahead window, in pages
+  uint64 ra_lo;                // VA range of the last swap-in batch
+  int ra_n;                    // ... and its length in pages
+  struct mmap_region mmaps[NMMAP]; // mmap()ed files, below TRAPFRAME
+  int fsfault;                 // Faulting with file system locks held
+  int incopy;                  // In copyin()/copyout(): pages must stay mapped
+  int madv;                    // Access hint (MADV_*) for the pages
+  uint64 madv_lo, madv_hi;     // ... of [madv_lo, madv_hi)
+  struct pagingstat pstat;     // Paging counters; vmlock held to update
+  int nresident;               // Pages on the resident queue
+  int rsslimit;                // Max resident pages, 0 for no limit
+  int wss;                     // Working-set estimate, in pages
+  uint wss_tick;               // ticks at the last working-set sample
   uint64 stack_bottom;         // Bottom of stack region
   uint64 stack_top;            // Top of original stack region (set at exec)
   uint64 heap_start;           // Start of heap region (after text/data)
-  uint swap_slots[MAX_SWAP_PAGES / 32]; // Bitmap for swap slot allocation (1024 bits / 32 = 32 uints)
-  int nswap_slots;             // Number of used swap slots
 };
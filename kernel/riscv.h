@@ -355,11 +355,18 @@ typedef uint64 *pagetable_t; // 512 PTEs
 #define PGROUNDUP(sz)  (((sz)+PGSIZE-1) & ~(PGSIZE-1))
 #define PGROUNDDOWN(a) (((a)) & ~(PGSIZE-1))
 
+#define MEGASIZE (PGSIZE*512) // bytes mapped by a level-1 leaf PTE
+#define MEGAROUNDUP(sz)  (((sz)+MEGASIZE-1) & ~(MEGASIZE-1))
+#define MEGAROUNDDOWN(a) (((a)) & ~(MEGASIZE-1))
+
 #define PTE_V (1L << 0) // valid
 #define PTE_R (1L << 1)
 #define PTE_W (1L << 2)
 #define PTE_X (1L << 3)
 #define PTE_U (1L << 4) // user can access
+#define PTE_A (1L << 6) // accessed, set by hardware
+#define PTE_D (1L << 7) // dirty, set by hardware
+#define PTE_COW (1L << 8) // RSW: copy-on-write, W cleared until written
 
 // shift a physical address to the right place for a PTE.
 #define PA2PTE(pa) ((((uint64)pa) >> 12) << 10)
@@ -368,6 +375,10 @@ typedef uint64 *pagetable_t; // 512 PTEs
 
 #define PTE_FLAGS(pte) ((pte) & 0x3FF)
 
+// a valid PTE with any of R, W, X maps memory; otherwise it
+// points to the next level's page table.
+#define PTE_LEAF(pte) ((pte) & (PTE_R|PTE_W|PTE_X))
+
 // extract the three 9-bit page table indices from a virtual address.
 #define PXMASK          0x1FF // 9 bits
 #define PXSHIFT(level)  (PGSHIFT+(9*(level)))
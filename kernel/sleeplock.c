@@ -6,8 +6,8 @@
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
-#include "proc.h"
 #include "sleeplock.h"
+#include "proc.h"
 
 void
 initsleeplock(struct sleeplock *lk, char *name)
@@ -30,6 +30,23 @@ acquiresleep(struct sleeplock *lk)
   release(&lk->lk);
 }
 
+// Acquire the lock only if it is free, without sleeping.
+// Returns 1 if the lock was acquired.
+int
+tryacquiresleep(struct sleeplock *lk)
+{
+  int r = 0;
+
+  acquire(&lk->lk);
+  if(!lk->locked) {
+    lk->locked = 1;
+    lk->pid = myproc()->pid;
+    r = 1;
+  }
+  release(&lk->lk);
+  return r;
+}
+
 void
 releasesleep(struct sleeplock *lk)
 {
@@ -3,6 +3,7 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "syscall.h"
 #include "defs.h"
@@ -102,6 +103,21 @@ extern uint64 sys_link(void);
 extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
 extern uint64 sys_memstat(void);
+extern uint64 sys_pagealgo(void);
+extern uint64 sys_pagescope(void);
+extern uint64 sys_pagewmark(void);
+extern uint64 sys_vmstat(void);
+extern uint64 sys_swapcluster(void);
+extern uint64 sys_faultaround(void);
+extern uint64 sys_traceread(void);
+extern uint64 sys_tracecons(void);
+extern uint64 sys_megapages(void);
+extern uint64 sys_madvise(void);
+extern uint64 sys_mmap(void);
+extern uint64 sys_munmap(void);
+extern uint64 sys_pagingstat(void);
+extern uint64 sys_rsslimit(void);
+extern uint64 sys_zswap(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -128,6 +144,21 @@ static uint64 (*syscalls[])(void) = {
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
 [SYS_memstat] sys_memstat,
+[SYS_pagealgo] sys_pagealgo,
+[SYS_pagescope] sys_pagescope,
+[SYS_pagewmark] sys_pagewmark,
+[SYS_vmstat] sys_vmstat,
+[SYS_swapcluster] sys_swapcluster,
+[SYS_faultaround] sys_faultaround,
+[SYS_traceread] sys_traceread,
+[SYS_tracecons] sys_tracecons,
+[SYS_megapages] sys_megapages,
+[SYS_madvise]  sys_madvise,
+[SYS_mmap]     sys_mmap,
+[SYS_munmap]   sys_munmap,
+[SYS_pagingstat] sys_pagingstat,
+[SYS_rsslimit] sys_rsslimit,
+[SYS_zswap]    sys_zswap,
 };
 
 void
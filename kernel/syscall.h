@@ -21,3 +21,18 @@
 #define SYS_mkdir  20
 #define SYS_close  21
 #define SYS_memstat 22
+#define SYS_pagealgo 23
+#define SYS_pagescope 24
+#define SYS_pagewmark 25
+#define SYS_vmstat 26
+#define SYS_swapcluster 27
+#define SYS_faultaround 28
+#define SYS_traceread  29
+#define SYS_tracecons  30
+#define SYS_megapages  31
+#define SYS_madvise    32
+#define SYS_mmap       33
+#define SYS_munmap     34
+#define SYS_pagingstat 35
+#define SYS_rsslimit   36
+#define SYS_zswap      37
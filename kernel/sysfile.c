@@ -10,9 +10,9 @@
 #include "param.h"
 #include "stat.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "fs.h"
-#include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
 
@@ -503,3 +503,40 @@ sys_pipe(void)
   }
   return 0;
 }
+
+// Map len bytes of open file fd, from page-aligned offset off,
+// into the address space; addr must be 0. prot is PROT_READ, plus
+// PROT_WRITE or PROT_EXEC, and flags MAP_SHARED or MAP_PRIVATE.
+uint64
+sys_mmap(void)
+{
+  uint64 addr;
+  int len, prot, flags, off;
+  struct file *f;
+
+  argaddr(0, &addr);
+  argint(1, &len);
+  argint(2, &prot);
+  argint(3, &flags);
+  if(argfd(4, 0, &f) < 0)
+    return -1;
+  argint(5, &off);
+  if(addr != 0 || len <= 0 || off < 0)
+    return -1;
+  return mmap(f, len, prot, flags, off);
+}
+
+// Unmap [addr, addr+len), from the start or end of a mapping,
+// writing shared pages back to the file.
+uint64
+sys_munmap(void)
+{
+  uint64 addr;
+  int len;
+
+  argaddr(0, &addr);
+  argint(1, &len);
+  if(len <= 0)
+    return -1;
+  return munmap(addr, len);
+}
@@ -4,6 +4,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "vm.h"
 #include "memstat.h"
@@ -50,32 +51,19 @@ sys_sbrk(void)
   addr = p->sz;
 
   if(t == SBRK_EAGER || n < 0) {
+    acquiresleep(&p->vmlock);
     if(growproc(n) < 0) {
+      releasesleep(&p->vmlock);
       return -1;
     }
-    // When shrinking, remove pages[] entries for freed region
-    if(n < 0) {
-      uint64 newsz = p->sz;
-      for(int i = 0; i < p->npages; ) {
-        if(p->pages[i].va >= newsz) {
-          // This page is beyond new heap; remove it
-          // Shift remaining entries down
-          for(int j = i; j < p->npages - 1; j++) {
-            p->pages[j] = p->pages[j + 1];
-          }
-          p->npages--;
-        } else {
-          i++;
-        }
-      }
-    }
+    releasesleep(&p->vmlock);
   } else {
     // Lazily allocate memory for this process: increase its memory
     // size but don't allocate memory. If the processes uses the
     // memory, vmfault() will allocate it.
     if(addr + n < addr)
       return -1;
-    if(addr + n > TRAPFRAME)
+    if(addr + n > mmap_floor(p))
       return -1;
     p->sz += n;
   }
@@ -126,6 +114,41 @@ sys_uptime(void)
   return xticks;
 }
 
+// Select the calling process's page replacement algorithm.
+// A negative argument only queries it. Returns the previous
+// algorithm, or -1 if the argument is not a PAGEALGO_* value.
+uint64
+sys_pagealgo(void)
+{
+  int algo, old;
+  struct proc *p = myproc();
+
+  argint(0, &algo);
+  if(algo > PAGEALGO_CLOCK)
+    return -1;
+  old = p->pagealgo;
+  if(algo >= 0)
+    p->pagealgo = algo;
+  return old;
+}
+
+// Select the replacement scope for the whole system.
+// A negative argument only queries it. Returns the previous
+// scope, or -1 if the argument is not a PAGESCOPE_* value.
+uint64
+sys_pagescope(void)
+{
+  int scope, old;
+
+  argint(0, &scope);
+  if(scope > PAGESCOPE_GLOBAL)
+    return -1;
+  old = pagescope;
+  if(scope >= 0)
+    pagescope = scope;
+  return old;
+}
+
 // Get memory statistics for the calling process
 uint64
 sys_memstat(void)
@@ -133,6 +156,7 @@ sys_memstat(void)
   uint64 addr;
   struct proc *p = myproc();
   struct proc_mem_stat st;
+  struct page_info *pi;
   int i;
   uint64 page_va;
 
@@ -141,33 +165,48 @@ sys_memstat(void)
   // Clear structure
   memset(&st, 0, sizeof(st));
 
+  acquiresleep(&p->vmlock);
+
   // Basic process info
   st.pid = p->pid;
   st.next_fifo_seq = p->next_seq;
+  st.rss = p->nresident;
+  st.rss_limit = p->rsslimit;
+  st.wss = p->wss;
   st.num_pages_total = PGROUNDUP(p->sz) / PGSIZE;
 
   // Fill page info array
-  for(i = 0; i < p->npages && i < MAX_PAGES_INFO; i++) {
+  i = 0;
+  for(pi = page_info_first(p); pi && i < MAX_PAGES_INFO; pi = page_info_next(pi)) {
+    if(!pi->used)
+      continue;
+
     // Set basic page info
-    st.pages[i].va = p->pages[i].va;
-    st.pages[i].is_dirty = p->pages[i].dirty;
-    st.pages[i].seq = p->pages[i].seq;
+    st.pages[i].va = pi->va;
+    st.pages[i].is_dirty = page_is_dirty(p, pi);
+    st.pages[i].seq = pi->seq;
 
     // Set page state and update counters
-    if(p->pages[i].resident) {
+    if(pi->resident) {
       st.pages[i].state = RESIDENT;
       st.pages[i].swap_slot = -1;
       st.num_resident_pages++;
     }
-    else if(p->pages[i].swapped) {
+    else if(pi->swapped) {
       st.pages[i].state = SWAPPED;
-      st.pages[i].swap_slot = p->pages[i].swap_offset;
+      st.pages[i].swap_slot = pi->swap_offset;
       st.num_swapped_pages++;
     }
+    else if(pi->zero) {
+      st.pages[i].state = ZEROPAGE;
+      st.pages[i].swap_slot = -1;
+      st.num_zero_pages++;
+    }
     else {
       st.pages[i].state = UNMAPPED;
       st.pages[i].swap_slot = -1;
     }
+    i++;
   }
 
   // Fill remaining slots with unmapped pages if there's room
@@ -183,9 +222,175 @@ sys_memstat(void)
     }
   }
 
+  releasesleep(&p->vmlock);
+
   // Copy to user space
   if(copyout(p->pagetable, addr, (char*)&st, sizeof(st)) < 0)
     return -1;
 
   return 0;
 }
+
+// Set how many pages eviction may write per disk request,
+// 1 to SWAPCLUSTER. A non-positive argument only queries it.
+// Returns the previous value, or -1 if n is too large.
+uint64
+sys_swapcluster(void)
+{
+  int n, old;
+
+  argint(0, &n);
+  if(n > SWAPCLUSTER)
+    return -1;
+  old = swapcluster;
+  if(n > 0)
+    swapcluster = n;
+  return old;
+}
+
+// Set how many pages an executable page fault may load,
+// 1 to FAULTAROUND. A non-positive argument only queries it.
+// Returns the previous value, or -1 if n is too large.
+uint64
+sys_faultaround(void)
+{
+  int n, old;
+
+  argint(0, &n);
+  if(n > FAULTAROUND)
+    return -1;
+  old = faultaround;
+  if(n > 0)
+    faultaround = n;
+  return old;
+}
+
+// Read up to n paging trace records into a user array.
+// Returns the number read.
+uint64
+sys_traceread(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  if(n < 0)
+    return -1;
+  return traceread(addr, n);
+}
+
+// Turn console printing of paging events on (1) or off (0).
+// A negative argument only queries it. Returns the previous value.
+uint64
+sys_tracecons(void)
+{
+  int on, old;
+
+  argint(0, &on);
+  old = traceconsole;
+  if(on >= 0)
+    traceconsole = on != 0;
+  return old;
+}
+
+// Turn megapage mappings of the lazy heap on (1) or off (0).
+// A negative argument only queries it. Returns the previous value.
+uint64
+sys_megapages(void)
+{
+  int on, old;
+
+  argint(0, &on);
+  old = megapages;
+  if(on >= 0)
+    megapages = on != 0;
+  return old;
+}
+
+// Limit the resident set of the calling process to n pages
+// (0: no limit; negative: query). Returns the previous limit.
+uint64
+sys_rsslimit(void)
+{
+  int n;
+
+  argint(0, &n);
+  return rsslimit(n);
+}
+
+// Turn the compressed swap cache on (1) or off (0) for pages
+// swapped out from now on. A negative argument only queries it.
+// Returns the previous value.
+uint64
+sys_zswap(void)
+{
+  int on, old;
+
+  argint(0, &on);
+  old = zswap;
+  if(on >= 0)
+    zswap = on != 0;
+  return old;
+}
+
+// Tell the pager how the pages of [addr, addr+len) will be
+// used (MADV_*). addr must be page-aligned.
+uint64
+sys_madvise(void)
+{
+  uint64 addr;
+  int len, advice;
+
+  argaddr(0, &addr);
+  argint(1, &len);
+  argint(2, &advice);
+  if(len <= 0)
+    return -1;
+  return madvise(addr, len, advice);
+}
+
+// Set the page-out daemon's low and high watermarks, in free pages.
+// A low watermark of 0 keeps the daemon asleep.
+uint64
+sys_pagewmark(void)
+{
+  int low, high;
+
+  argint(0, &low);
+  argint(1, &high);
+  return pageout_setwmark(low, high);
+}
+
+// Get system-wide memory statistics, by subsystem
+uint64
+sys_vmstat(void)
+{
+  uint64 addr;
+  struct vmstat st;
+
+  argaddr(0, &addr);
+  vmstat(&st);
+  if(copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
+
+// Copy the paging counters and latency histograms of process pid,
+// or the system-wide ones if pid is 0, to the struct pagingstat
+// at addr.
+uint64
+sys_pagingstat(void)
+{
+  int pid;
+  uint64 addr;
+  struct pagingstat st;
+
+  argint(0, &pid);
+  argaddr(1, &addr);
+  if(pagingstat(pid, &st) < 0)
+    return -1;
+  if(copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
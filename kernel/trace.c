@@ -0,0 +1,191 @@
+// Paging event trace.
+//
+// The fault and eviction paths record compact binary events into
+// a ring per CPU instead of printing them: a printf takes the
+// global pr lock and waits on the UART for every character.
+// A writer only touches its own CPU's ring, with interrupts off,
+// so it needs no lock. traceread() drains the rings; each record
+// carries its sequence number, written last, so the reader can
+// tell a complete record from one a writer is overwriting.
+//
+// With traceconsole set (tracecons()), every event is also
+// printed in the old "[pid N] EVENT ..." form.
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "riscv.h"
+#include "proc.h"
+#include "defs.h"
+#include "trace.h"
+#include "vm.h"
+
+struct tracebuf {
+  struct trace_rec rec[TRACESIZE];
+  uint64 head;      // records written; only this CPU changes it
+  uint64 tail;      // records consumed; only the reader changes it
+  uint64 lost;      // records overwritten before they were read
+} __attribute__((aligned(64)));
+
+static struct tracebuf tbuf[NCPU];
+static struct sleeplock treader;
+
+int traceconsole = TRACECONSOLE;
+
+static char *trace_names[] = {
+[TR_PAGEFAULT]   "PAGEFAULT",
+[TR_ALLOC]       "ALLOC",
+[TR_RESIDENT]    "RESIDENT",
+[TR_LOADEXEC]    "LOADEXEC",
+[TR_FAULTAROUND] "FAULTAROUND",
+[TR_ZEROPAGE]    "ZEROPAGE",
+[TR_COW]         "COW",
+[TR_SWAPIN]      "SWAPIN",
+[TR_READAHEAD]   "READAHEAD",
+[TR_VICTIM]      "VICTIM",
+[TR_EVICT]       "EVICT",
+[TR_SWAPOUT]     "SWAPOUT",
+[TR_SWAPKEEP]    "SWAPKEEP",
+[TR_DISCARD]     "DISCARD",
+[TR_MEMFULL]     "MEMFULL",
+[TR_SWAPCLEANUP] "SWAPCLEANUP",
+[TR_MEGAPAGE]    "MEGAPAGE",
+[TR_WRITEBACK]   "WRITEBACK",
+[TR_RSSLIMIT]    "RSSLIMIT",
+};
+
+static char *access_names[] = { "exec", "read", "write" };
+static char *cause_names[] = { "swap", "exec", "heap", "stack", "mmap" };
+static char *algo_names[] = {
+[PAGEALGO_FIFO]  "FIFO",
+[PAGEALGO_CLOCK] "CLOCK",
+};
+
+void
+traceinit(void)
+{
+  initsleeplock(&treader, "trace");
+}
+
+// Print r the way the paging code used to log it.
+static void
+trace_print(struct trace_rec *r)
+{
+  char *name = trace_names[r->type];
+
+  switch(r->type){
+  case TR_PAGEFAULT:
+    printf("[pid %d] %s va=0x%lx access=%s cause=%s\n", r->pid, name, r->va,
+           access_names[r->a & 0xf], cause_names[r->a >> 4]);
+    break;
+  case TR_RESIDENT:
+    printf("[pid %d] %s va=0x%lx seq=%d\n", r->pid, name, r->va, r->b);
+    break;
+  case TR_SWAPIN:
+  case TR_READAHEAD:
+  case TR_SWAPOUT:
+  case TR_SWAPKEEP:
+    printf("[pid %d] %s va=0x%lx slot=%d\n", r->pid, name, r->va, r->b);
+    break;
+  case TR_VICTIM:
+    printf("[pid %d] %s va=0x%lx seq=%d algo=%s\n", r->pid, name, r->va, r->b,
+           algo_names[r->a]);
+    break;
+  case TR_EVICT:
+    printf("[pid %d] %s va=0x%lx state=%s\n", r->pid, name, r->va,
+           r->a ? "dirty" : "clean");
+    break;
+  case TR_MEMFULL:
+    printf("[pid %d] %s\n", r->pid, name);
+    break;
+  case TR_SWAPCLEANUP:
+    printf("[pid %d] %s freed_slots=%d\n", r->pid, name, r->b);
+    break;
+  default:
+    printf("[pid %d] %s va=0x%lx\n", r->pid, name, r->va);
+    break;
+  }
+}
+
+// Record an event on this CPU's ring.
+void
+trace(int type, int pid, uint64 va, int a, int b)
+{
+  struct trace_rec r, *slot;
+  struct tracebuf *t;
+
+  r.time = r_time();
+  r.va = va;
+  r.pid = pid;
+  r.type = type;
+  r.a = a;
+  r.b = b;
+
+  push_off();
+  r.cpu = cpuid();
+  t = &tbuf[r.cpu];
+  slot = &t->rec[t->head % TRACESIZE];
+  r.seq = t->head + 1;
+  slot->seq = 0;            // invalid while it is rewritten
+  __sync_synchronize();
+  slot->time = r.time;
+  slot->va = r.va;
+  slot->pid = r.pid;
+  slot->type = r.type;
+  slot->cpu = r.cpu;
+  slot->a = r.a;
+  slot->b = r.b;
+  __sync_synchronize();
+  slot->seq = r.seq;
+  t->head++;
+  pop_off();
+
+  if(traceconsole)
+    trace_print(&r);
+}
+
+// Copy up to n unread records to user address dst, CPU by CPU,
+// oldest first within each CPU. Returns the number copied, or -1.
+int
+traceread(uint64 dst, int n)
+{
+  struct proc *p = myproc();
+  struct trace_rec r;
+  int got = 0;
+
+  acquiresleep(&treader);
+  for(int c = 0; c < NCPU && got < n; c++){
+    struct tracebuf *t = &tbuf[c];
+    while(got < n){
+      uint64 head = t->head;
+      __sync_synchronize();
+      if(t->tail == head)
+        break;
+      if(head - t->tail > TRACESIZE){
+        t->lost += head - TRACESIZE - t->tail;
+        t->tail = head - TRACESIZE;
+      }
+      struct trace_rec *slot = &t->rec[t->tail % TRACESIZE];
+      uint seq = slot->seq;
+      __sync_synchronize();
+      r = *slot;
+      __sync_synchronize();
+      // Overwritten while we looked: skip it.
+      if(seq != t->tail + 1 || slot->seq != seq){
+        t->lost++;
+        t->tail++;
+        continue;
+      }
+      r.seq = seq;
+      t->tail++;
+      if(copyout(p->pagetable, dst + got * sizeof(r), (char*)&r, sizeof(r)) < 0){
+        releasesleep(&treader);
+        return -1;
+      }
+      got++;
+    }
+  }
+  releasesleep(&treader);
+  return got;
+}
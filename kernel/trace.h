@@ -0,0 +1,51 @@
+// trace.h - paging event trace records, see kernel/trace.c
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+// Event types, with the meaning of each record's a and b
+#define TR_PAGEFAULT   1   // a = access | cause << 4
+#define TR_ALLOC       2
+#define TR_RESIDENT    3   // b = seq
+#define TR_LOADEXEC    4
+#define TR_FAULTAROUND 5
+#define TR_ZEROPAGE    6
+#define TR_COW         7
+#define TR_SWAPIN      8   // b = slot
+#define TR_READAHEAD   9   // b = slot
+#define TR_VICTIM     10   // a = PAGEALGO_*, b = seq
+#define TR_EVICT      11   // a = 1 if dirty
+#define TR_SWAPOUT    12   // b = slot
+#define TR_SWAPKEEP   13   // b = slot
+#define TR_DISCARD    14
+#define TR_MEMFULL    15
+#define TR_SWAPCLEANUP 16  // b = slots freed
+#define TR_MEGAPAGE   17   // va = start of the megapage
+#define TR_WRITEBACK  18   // mmap(MAP_SHARED) page written to its file
+#define TR_RSSLIMIT   19   // a = resident pages, b = limit (rsslimit)
+#define TR_NTYPES     20
+
+// TR_PAGEFAULT access
+#define TRA_EXEC  0
+#define TRA_READ  1
+#define TRA_WRITE 2
+
+// TR_PAGEFAULT cause
+#define TRC_SWAP  0
+#define TRC_EXEC  1
+#define TRC_HEAP  2
+#define TRC_STACK 3
+#define TRC_MMAP  4
+
+struct trace_rec {
+  uint64 time;      // timer ticks (r_time) when recorded
+  uint64 va;
+  int pid;
+  uchar type;       // TR_*
+  uchar cpu;
+  ushort a;
+  int b;
+  uint seq;         // position in its CPU's stream, plus one
+};
+
+#endif // _TRACE_H_
@@ -47,6 +47,7 @@ static struct disk {
   // indexed by first descriptor index of chain.
   struct {
     struct buf *b;
+    char done;     // raw page request finished (b == 0)
     char status;
   } info[NUM];
 
@@ -196,12 +197,11 @@ free_chain(int i)
   }
 }
 
-// allocate three descriptors (they need not be contiguous).
-// disk transfers always use three descriptors.
+// allocate n descriptors (they need not be contiguous).
 static int
-alloc3_desc(int *idx)
+allocn_desc(int *idx, int n)
 {
-  for(int i = 0; i < 3; i++){
+  for(int i = 0; i < n; i++){
     idx[i] = alloc_desc();
     if(idx[i] < 0){
       for(int j = 0; j < i; j++)
@@ -212,6 +212,13 @@ alloc3_desc(int *idx)
   return 0;
 }
 
+// block transfers through the buffer cache always use three descriptors.
+static int
+alloc3_desc(int *idx)
+{
+  return allocn_desc(idx, 3);
+}
+
 void
 virtio_disk_rw(struct buf *b, int write)
 {
@@ -291,6 +298,89 @@ virtio_disk_rw(struct buf *b, int write)
   release(&disk.vdisk_lock);
 }
 
+// disk size in 512-byte sectors.
+uint64
+virtio_disk_capacity(void)
+{
+  return *(volatile uint64 *)(VIRTIO0 + VIRTIO_MMIO_CONFIG);
+}
+
+// read or write n len-byte chunks at consecutive disk sectors
+// starting at blockno. the chunks need not be contiguous in memory:
+// each gets its own data descriptor, so one request moves at most
+// NUM-2 of them.
+static void
+virtio_disk_rwv(uint blockno, uint64 *pa, uint len, int n, int write)
+{
+  uint64 sector = blockno * (BSIZE / 512);
+  int idx[NUM];
+
+  if(n < 1 || n > NUM - 2)
+    panic("virtio_disk_rwv");
+
+  acquire(&disk.vdisk_lock);
+
+  while(1){
+    if(allocn_desc(idx, n + 2) == 0) {
+      break;
+    }
+    sleep(&disk.free[0], &disk.vdisk_lock);
+  }
+
+  struct virtio_blk_req *buf0 = &disk.ops[idx[0]];
+
+  if(write)
+    buf0->type = VIRTIO_BLK_T_OUT; // write the disk
+  else
+    buf0->type = VIRTIO_BLK_T_IN; // read the disk
+  buf0->reserved = 0;
+  buf0->sector = sector;
+
+  disk.desc[idx[0]].addr = (uint64) buf0;
+  disk.desc[idx[0]].len = sizeof(struct virtio_blk_req);
+  disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
+  disk.desc[idx[0]].next = idx[1];
+
+  for(int i = 1; i <= n; i++){
+    disk.desc[idx[i]].addr = pa[i-1];
+    disk.desc[idx[i]].len = len;
+    if(write)
+      disk.desc[idx[i]].flags = 0; // device reads the page
+    else
+      disk.desc[idx[i]].flags = VRING_DESC_F_WRITE; // device writes the page
+    disk.desc[idx[i]].flags |= VRING_DESC_F_NEXT;
+    disk.desc[idx[i]].next = idx[i+1];
+  }
+
+  disk.info[idx[0]].status = 0xff; // device writes 0 on success
+  disk.desc[idx[n+1]].addr = (uint64) &disk.info[idx[0]].status;
+  disk.desc[idx[n+1]].len = 1;
+  disk.desc[idx[n+1]].flags = VRING_DESC_F_WRITE; // device writes the status
+  disk.desc[idx[n+1]].next = 0;
+
+  // no struct buf; virtio_disk_intr() sets done instead.
+  disk.info[idx[0]].b = 0;
+  disk.info[idx[0]].done = 0;
+
+  disk.avail->ring[disk.avail->idx % NUM] = idx[0];
+
+  __sync_synchronize();
+
+  disk.avail->idx += 1; // not % NUM ...
+
+  __sync_synchronize();
+
+  *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
+
+  while(disk.info[idx[0]].done == 0) {
+    sleep(&disk.info[idx[0]], &disk.vdisk_lock);
+  }
+
+  free_chain(idx[0]);
+
+  release(&disk.vdisk_lock);
+}
+
 void
 virtio_disk_intr()
 {
@@ -317,11 +407,36 @@ virtio_disk_intr()
       panic("virtio_disk_intr status");
 
     struct buf *b = disk.info[id].b;
-    b->disk = 0;   // disk is done with buf
-    wakeup(b);
+    if(b){
+      b->disk = 0;   // disk is done with buf
+      wakeup(b);
+    } else {
+      disk.info[id].done = 1;
+      wakeup(&disk.info[id]);
+    }
 
     disk.used_idx += 1;
   }
 
   release(&disk.vdisk_lock);
 }
+
+// read or write n whole pages at consecutive disk blocks starting
+// at blockno, bypassing the buffer cache.
+void
+virtio_disk_rwpages(uint blockno, uint64 *pa, int n, int write)
+{
+  virtio_disk_rwv(blockno, pa, PGSIZE, n, write);
+}
+
+// read n bufs that hold consecutive disk blocks with one request.
+// the caller holds their locks and marks them valid.
+void
+virtio_disk_readbufs(struct buf **b, int n)
+{
+  uint64 pa[NUM];
+
+  for(int i = 0; i < n; i++)
+    pa[i] = (uint64) b[i]->data;
+  virtio_disk_rwv(b[0]->blockno, pa, BSIZE, n, 0);
+}
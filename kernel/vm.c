@@ -5,12 +5,15 @@
 #include "riscv.h"
 #include "defs.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "fs.h"
-#include "sleeplock.h"
 #include "file.h"
 #include "stat.h"
 #include "fcntl.h"
+#include "vm.h"
+#include "memstat.h"
+#include "trace.h"
 
 /*
  * the kernel's page table.
@@ -21,6 +24,8 @@ extern char etext[];  // kernel.ld sets this to end of kernel code.
 
 extern char trampoline[]; // trampoline.S
 
+extern struct superblock sb; // fs.c
+
 // Make a direct-map page table for the kernel.
 pagetable_t
 kvmmake(void)
@@ -86,6 +91,93 @@ kvminithart()
   sfence_vma();
 }
 
+static struct mega_stat megastat;  // updated with atomic adds, see vmstat
+
+// System-wide paging counters. Each event is counted for its
+// process, under its vmlock, and here with atomic adds.
+static struct pagingstat gpstat;
+
+// Count a page fault of p with cause PF_*.
+static void
+pstat_fault(struct proc *p, int cause)
+{
+  p->pstat.faults[cause]++;
+  __sync_fetch_and_add(&gpstat.faults[cause], 1);
+}
+
+// Count an eviction of a page of p.
+static void
+pstat_evict(struct proc *p, int discarded)
+{
+  p->pstat.evicted++;
+  __sync_fetch_and_add(&gpstat.evicted, 1);
+  if(discarded) {
+    p->pstat.discarded++;
+    __sync_fetch_and_add(&gpstat.discarded, 1);
+  }
+}
+
+// Count npages moved between memory and swap for p.
+static void
+pstat_swap(struct proc *p, int npages, int write)
+{
+  uint64 n = (uint64)npages * PGSIZE;
+
+  if(write) {
+    p->pstat.swapout_bytes += n;
+    __sync_fetch_and_add(&gpstat.swapout_bytes, n);
+  } else {
+    p->pstat.swapin_bytes += n;
+    __sync_fetch_and_add(&gpstat.swapin_bytes, n);
+  }
+}
+
+// Add the time since t0 (time CSR) to p's LAT_* histogram what.
+static void
+pstat_time(struct proc *p, int what, uint64 t0)
+{
+  uint64 d = r_time() - t0;
+  int b = 0;
+
+  while(d > 1 && b < LATBUCKETS - 1) {
+    d >>= 1;
+    b++;
+  }
+  p->pstat.lat[what][b]++;
+  __sync_fetch_and_add(&gpstat.lat[what][b], 1);
+}
+
+// Copy the paging counters of process pid, or the system-wide ones
+// if pid is 0, to st. Returns -1 if there is no such process.
+int
+pagingstat(int pid, struct pagingstat *st)
+{
+  if(pid == 0) {
+    *st = gpstat;
+    return 0;
+  }
+  return proc_pagingstat(pid, st);
+}
+
+// Replace the megapage leaf *pte with a level-0 page table that
+// maps the same frames with the same flags, one PTE per page.
+// Returns -1 if out of memory.
+static int
+megasplit(pte_t *pte)
+{
+  pagetable_t pt;
+  uint64 pa = PTE2PA(*pte);
+  uint flags = PTE_FLAGS(*pte);
+
+  if((pt = (pagetable_t)kalloc()) == 0)
+    return -1;
+  for(int i = 0; i < 512; i++)
+    pt[i] = PA2PTE(pa + i*PGSIZE) | flags;
+  *pte = PA2PTE(pt) | PTE_V;
+  __sync_fetch_and_add(&megastat.splits, 1);
+  return 0;
+}
+
 // Return the address of the PTE in page table pagetable
 // that corresponds to virtual address va.  If alloc!=0,
 // create any required page-table pages.
@@ -98,6 +190,10 @@ kvminithart()
 //   21..29 -- 9 bits of level-1 index.
 //   12..20 -- 9 bits of level-0 index.
 //    0..11 -- 12 bits of byte offset within the page.
+//
+// A megapage on the way is first split into 4096-byte pages, since
+// the caller may change the PTE; walk() returns 0 if there is no
+// memory for the new page-table page.
 pte_t *
 walk(pagetable_t pagetable, uint64 va, int alloc)
 {
@@ -106,6 +202,8 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
 
   for(int level = 2; level > 0; level--) {
     pte_t *pte = &pagetable[PX(level, va)];
+    if((*pte & PTE_V) && PTE_LEAF(*pte) && megasplit(pte) < 0)
+      return 0;
     if(*pte & PTE_V) {
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
@@ -118,6 +216,51 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
   return &pagetable[PX(0, va)];
 }
 
+// Like walk(), but for looking only: return a megapage's level-1
+// PTE rather than split it, and set *mega. Never allocates.
+static pte_t *
+walkleaf(pagetable_t pagetable, uint64 va, int *mega)
+{
+  *mega = 0;
+  if(va >= MAXVA)
+    return 0;
+
+  for(int level = 2; level > 0; level--) {
+    pte_t *pte = &pagetable[PX(level, va)];
+    if((*pte & PTE_V) == 0)
+      return 0;
+    if(level == 1 && PTE_LEAF(*pte)) {
+      *mega = 1;
+      return pte;
+    }
+    pagetable = (pagetable_t)PTE2PA(*pte);
+  }
+  return &pagetable[PX(0, va)];
+}
+
+// Install leaf PTE pte for a megapage at the MEGASIZE-aligned va,
+// allocating the level-1 page table if need be. Returns -1 if
+// that fails or anything is mapped there already.
+static int
+megamap(pagetable_t pagetable, uint64 va, pte_t pte)
+{
+  pte_t *l2 = &pagetable[PX(2, va)];
+  pagetable_t l1;
+
+  if(*l2 & PTE_V) {
+    l1 = (pagetable_t)PTE2PA(*l2);
+  } else {
+    if((l1 = (pagetable_t)kalloc()) == 0)
+      return -1;
+    memset(l1, 0, PGSIZE);
+    *l2 = PA2PTE(l1) | PTE_V;
+  }
+  if(l1[PX(1, va)] & PTE_V)
+    return -1;
+  l1[PX(1, va)] = pte;
+  return 0;
+}
+
 // Look up a virtual address, return the physical address,
 // or 0 if not mapped.
 // Can only be used to look up user pages.
@@ -126,11 +269,12 @@ walkaddr(pagetable_t pagetable, uint64 va)
 {
   pte_t *pte;
   uint64 pa;
+  int mega;
 
   if(va >= MAXVA)
     return 0;
 
-  pte = walk(pagetable, va, 0);
+  pte = walkleaf(pagetable, va, &mega);
   if(pte == 0)
     return 0;
   if((*pte & PTE_V) == 0)
@@ -138,6 +282,8 @@ walkaddr(pagetable_t pagetable, uint64 va)
   if((*pte & PTE_U) == 0)
     return 0;
   pa = PTE2PA(*pte);
+  if(mega)
+    pa += PGROUNDDOWN(va) & (MEGASIZE - 1);
   return pa;
 }
 
@@ -198,13 +344,30 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 {
   uint64 a;
   pte_t *pte;
+  int mega;
 
   if((va % PGSIZE) != 0)
     panic("uvmunmap: not aligned");
 
   for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
-    if((pte = walk(pagetable, a, 0)) == 0) // leaf page table entry allocated?
+    // A megapage inside the range goes whole; walk() splits
+    // one that is only partly inside.
+    if((a % MEGASIZE) == 0 && a + MEGASIZE <= va + npages*PGSIZE &&
+       (pte = walkleaf(pagetable, a, &mega)) != 0 && mega){
+      if(do_free){
+        for(int i = 0; i < MEGASIZE / PGSIZE; i++)
+          kfree((void*)(PTE2PA(*pte) + i*PGSIZE));
+      }
+      *pte = 0;
+      a += MEGASIZE - PGSIZE;
+      continue;
+    }
+    if((pte = walk(pagetable, a, 0)) == 0){ // leaf page table entry allocated?
+      // Partial unmaps go through unmap_range(), which splits first.
+      if(walkleaf(pagetable, a, &mega) != 0 && mega)
+        panic("uvmunmap: megasplit");
       continue;   
+    }
     if((*pte & PTE_V) == 0)  // has physical page been allocated?
       continue;
     if(do_free){
@@ -285,6 +448,43 @@ freewalk(pagetable_t pagetable)
   kfree((void*)pagetable);
 }
 
+// Unmap [va, end) from page-table page pt, whose PTEs each map
+// 512^level pages from base on: free the frames of leaf PTEs inside
+// the range, and free lower-level page-table pages that end up
+// empty. A megapage must not be only partly inside the range (see
+// unmap_range). Returns 1 if pt is empty.
+static int
+unmap_level(pagetable_t pt, int level, uint64 base, uint64 va, uint64 end)
+{
+  uint64 span = 1UL << (PGSHIFT + 9 * level);
+  int empty = 1;
+
+  for(int i = 0; i < 512; i++) {
+    uint64 lo = base + i * span;
+    pte_t *pte = &pt[i];
+
+    if((*pte & PTE_V) == 0)
+      continue;
+    if(lo + span <= va || lo >= end) {
+      empty = 0;
+      continue;
+    }
+    if(PTE_LEAF(*pte) && (lo < va || lo + span > end))
+      panic("unmap_level");
+    if(PTE_LEAF(*pte)) {
+      for(uint64 a = 0; a < span; a += PGSIZE)
+        kfree((void*)(PTE2PA(*pte) + a));
+      *pte = 0;
+    } else if(unmap_level((pagetable_t)PTE2PA(*pte), level - 1, lo, va, end)) {
+      kfree((void*)PTE2PA(*pte));
+      *pte = 0;
+    } else {
+      empty = 0;
+    }
+  }
+  return empty;
+}
+
 // Free user memory pages,
 // then free page-table pages.
 void
@@ -295,39 +495,60 @@ uvmfree(pagetable_t pagetable, uint64 sz)
   freewalk(pagetable);
 }
 
-// Given a parent process's page table, copy
-// its memory into a child's page table.
-// Copies both the page table and the
-// physical memory.
+// Given a parent process's page table, share
+// its memory with a child's page table.
+// Writable pages become read-only and PTE_COW in
+// both; the first write copies the page (see
+// cow_fault). Physical pages are not copied.
+// The caller must flush the parent's TLB.
 // returns 0 on success, -1 on failure.
 // frees any allocated pages on failure.
 int
 uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
+{
+  return uvmshare(old, new, 0, sz, 1);
+}
+
+// Share the pages mapped in [start, end) of old with new, as
+// uvmcopy() does; if cow is 0, writable pages stay writable in
+// both, so that writes by either are seen by the other.
+int
+uvmshare(pagetable_t old, pagetable_t new, uint64 start, uint64 end, int cow)
 {
   pte_t *pte;
   uint64 pa, i;
   uint flags;
-  char *mem;
-
-  for(i = 0; i < sz; i += PGSIZE){
+  int mega;
+
+  for(i = start; i < end; i += PGSIZE){
+    // A megapage is shared whole, copy-on-write like other pages.
+    if((i % MEGASIZE) == 0 && (pte = walkleaf(old, i, &mega)) != 0 && mega){
+      if(cow && (*pte & PTE_W))
+        *pte = (*pte & ~PTE_W) | PTE_COW;
+      if(megamap(new, i, *pte) != 0)
+        goto err;
+      pa = PTE2PA(*pte);
+      for(int j = 0; j < MEGASIZE / PGSIZE; j++)
+        kref((void*)(pa + j*PGSIZE));
+      i += MEGASIZE - PGSIZE;
+      continue;
+    }
     if((pte = walk(old, i, 0)) == 0)
       continue;   // page table entry hasn't been allocated
     if((*pte & PTE_V) == 0)
       continue;   // physical page hasn't been allocated
+    if(cow && (*pte & PTE_W))
+      *pte = (*pte & ~PTE_W) | PTE_COW;
     pa = PTE2PA(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
+    if(mappages(new, i, PGSIZE, pa, flags) != 0)
       goto err;
-    memmove(mem, (char*)pa, PGSIZE);
-    if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0){
-      kfree(mem);
-      goto err;
-    }
+    kref((void*)pa);
   }
   return 0;
 
  err:
-  uvmunmap(new, 0, i / PGSIZE, 1);
+  uvmunmap(new, start, (i - start) / PGSIZE, 1);
   return -1;
 }
 
@@ -344,6 +565,8 @@ uvmclear(pagetable_t pagetable, uint64 va)
   *pte &= ~PTE_U;
 }
 
+static uint64 uvmfault(pagetable_t, uint64, uint64);
+
 // Helper: check if a user VA is potentially valid (segment/heap/stack/swap)
 static int
 is_valid_user_va(struct proc *p, uint64 va)
@@ -363,6 +586,10 @@ is_valid_user_va(struct proc *p, uint64 va)
       return 1;
   }
 
+  // In a mapped file
+  if(mmap_find(p, va))
+    return 1;
+
   // In heap
   if(va >= p->heap_start && va < PGROUNDUP(p->sz) && va < p->stack_bottom)
     return 1;
@@ -376,14 +603,75 @@ is_valid_user_va(struct proc *p, uint64 va)
   return 0;
 }
 
+// Keep other processes from evicting the current process's pages
+// while a copy to or from them runs: the copy uses a physical
+// address looked up without vmlock, and kerneltrap() may preempt
+// it in between. See detach_page().
+static void
+copy_pin(int on)
+{
+  struct proc *p = myproc();
+
+  if(p == 0)
+    return;
+  acquire(&p->lock);
+  p->incopy += on ? 1 : -1;
+  release(&p->lock);
+}
+
+static int copyout_pinned(pagetable_t, uint64, char*, uint64);
+static int copyin_pinned(pagetable_t, char*, uint64, uint64);
+static int copyinstr_pinned(pagetable_t, char*, uint64, uint64);
+
 // Copy from kernel to user.
 // Copy len bytes from src to virtual address dstva in a given page table.
 // Return 0 on success, -1 on error.
 int
 copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
+{
+  int r;
+
+  copy_pin(1);
+  r = copyout_pinned(pagetable, dstva, src, len);
+  copy_pin(0);
+  return r;
+}
+
+// Copy from user to kernel.
+// Copy len bytes to dst from virtual address srcva in a given page table.
+// Return 0 on success, -1 on error.
+int
+copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
+{
+  int r;
+
+  copy_pin(1);
+  r = copyin_pinned(pagetable, dst, srcva, len);
+  copy_pin(0);
+  return r;
+}
+
+// Copy a null-terminated string from user to kernel.
+// Copy bytes to dst from virtual address srcva in a given page table,
+// until a '\0', or max.
+// Return 0 on success, -1 on error.
+int
+copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
+{
+  int r;
+
+  copy_pin(1);
+  r = copyinstr_pinned(pagetable, dst, srcva, max);
+  copy_pin(0);
+  return r;
+}
+
+static int
+copyout_pinned(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 {
   uint64 n, va0, pa0;
   pte_t *pte;
+  int mega;
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
@@ -391,16 +679,14 @@ copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
       return -1;
   
     pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0) {
+    // A write fault also breaks copy-on-write sharing.
+    if(pa0 == 0 || (*walkleaf(pagetable, va0, &mega) & PTE_COW)) {
       // Only try to fault-in if the VA looks valid for this process.
-      struct proc *p = myproc();
-      if(!is_valid_user_va(p, va0))
-        return -1;
-      if((pa0 = vmfault(pagetable, va0, 15)) == 0)
+      if((pa0 = uvmfault(pagetable, va0, 15)) == 0)
         return -1;
     }
 
-    pte = walk(pagetable, va0, 0);
+    pte = walkleaf(pagetable, va0, &mega);
     // forbid copyout over read-only user text pages.
     if((*pte & PTE_W) == 0)
       return -1;
@@ -417,11 +703,8 @@ copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
   return 0;
 }
 
-// Copy from user to kernel.
-// Copy len bytes to dst from virtual address srcva in a given page table.
-// Return 0 on success, -1 on error.
-int
-copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
+static int
+copyin_pinned(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 {
   uint64 n, va0, pa0;
 
@@ -432,10 +715,7 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
     pa0 = walkaddr(pagetable, va0);
     if(pa0 == 0) {
       // Only try to fault-in if the VA looks valid for this process.
-      struct proc *p = myproc();
-      if(!is_valid_user_va(p, va0))
-        return -1;
-      if((pa0 = vmfault(pagetable, va0, 13)) == 0)
+      if((pa0 = uvmfault(pagetable, va0, 13)) == 0)
         return -1;
     }
     n = PGSIZE - (srcva - va0);
@@ -450,12 +730,8 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
   return 0;
 }
 
-// Copy a null-terminated string from user to kernel.
-// Copy bytes to dst from virtual address srcva in a given page table,
-// until a '\0', or max.
-// Return 0 on success, -1 on error.
-int
-copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
+static int
+copyinstr_pinned(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 {
   uint64 n, va0, pa0;
   int got_null = 0;
@@ -467,10 +743,7 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
     pa0 = walkaddr(pagetable, va0);
     if(pa0 == 0) {
       // Only try to fault-in if the VA looks valid for this process.
-      struct proc *p = myproc();
-      if(!is_valid_user_va(p, va0))
-        return -1;
-      if((pa0 = vmfault(pagetable, va0, 13)) == 0)
+      if((pa0 = uvmfault(pagetable, va0, 13)) == 0)
         return -1;
     }
     n = PGSIZE - (srcva - va0);
@@ -501,402 +774,1823 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
   }
 }
 
+// Bucket in p->page_hash for a page-aligned virtual address.
+// Consecutive pages land in consecutive buckets.
+#define PAGE_HASH(va) (((va) >> PGSHIFT) & (PAGE_HASH_SIZE - 1))
+
+static void
+page_hash_insert(struct proc *p, struct page_info *pi)
+{
+  struct page_info **bucket = &p->page_hash[PAGE_HASH(pi->va)];
+  pi->hnext = *bucket;
+  *bucket = pi;
+}
+
+static void
+page_hash_remove(struct proc *p, struct page_info *pi)
+{
+  struct page_info **pp;
+
+  for(pp = &p->page_hash[PAGE_HASH(pi->va)]; *pp; pp = &(*pp)->hnext) {
+    if(*pp == pi) {
+      *pp = pi->hnext;
+      return;
+    }
+  }
+  panic("page_hash_remove");
+}
+
 // Find page info for a virtual address
 struct page_info*
 find_page_info(struct proc *p, uint64 va)
 {
+  struct page_info *pi;
+
   va = PGROUNDDOWN(va);
-  for(int i = 0; i < p->npages; i++) {
-    if(p->pages[i].va == va)
-      return &p->pages[i];
+  for(pi = p->page_hash[PAGE_HASH(va)]; pi; pi = pi->hnext) {
+    if(pi->va == va)
+      return pi;
   }
   return 0;
 }
 
-// Add a new page to tracking
+// System-wide list of resident pages for global replacement.
+// Pages are appended as they become resident, so the head is the
+// oldest resident page of any process.
+struct {
+  struct spinlock lock;
+  struct page_info *head;
+  struct page_info *tail;
+  int n;
+} gresident;
+
+int pagescope = PAGESCOPE;
+int swapcluster = SWAPCLUSTER;
+int faultaround = FAULTAROUND;
+int megapages = MEGAPAGES;
+
+// The swap area: raw disk blocks after the file system, shared by
+// all processes and written without the log (see swapinit).
+// Each slot holds one page and counts the page_info entries, in
+// any process, that point at it. The busy bitmap mirrors which
+// counts are non-zero, 64 slots a word, so that the allocator can
+// skip full words; slots past nslots are marked busy.
+#define SWAPWORDS ((SWAPPAGES + 63) / 64)
+struct {
+  struct spinlock lock;
+  uint start;                  // first disk block
+  int nslots;                  // pages that fit, at most SWAPPAGES
+  int nused;                   // slots in use
+  int next;                    // where the next search starts
+  uchar slotref[SWAPPAGES];    // references to each slot, 0 if free
+  uint64 busy[SWAPWORDS];      // bit set if slotref is non-zero
+} swaparea;
+
+// Frame of zeros that reads of untouched heap and stack pages map,
+// read-only and copy-on-write. Its kalloc() reference is never
+// dropped, so a write fault always copies it.
+static char *zeropage;
+
+// Page-out daemon state; see pageoutd().
+struct {
+  struct spinlock lock;
+  int kicked;
+  struct pageout_stat st;
+} pageout;
+
+// Readahead and fault-around counters.
+struct {
+  struct spinlock lock;
+  struct ra_stat st;
+} rastat;
+
+void
+pageinit(void)
+{
+  initlock(&gresident.lock, "gresident");
+  initlock(&pageout.lock, "pageout");
+  initlock(&rastat.lock, "rastat");
+  initlock(&swaparea.lock, "swaparea");
+  if((zeropage = kalloc()) == 0)
+    panic("pageinit: zeropage");
+  memset(zeropage, 0, PGSIZE);
+  pageout.st.low = PAGEOUT_LOW;
+  pageout.st.high = PAGEOUT_HIGH;
+}
+
+// Caller holds gresident.lock.
+static void
+gresident_link(struct page_info *pi)
+{
+  pi->gnext = 0;
+  pi->gprev = gresident.tail;
+  if(gresident.tail)
+    gresident.tail->gnext = pi;
+  else
+    gresident.head = pi;
+  gresident.tail = pi;
+  gresident.n++;
+}
+
+static void
+gresident_push(struct page_info *pi)
+{
+  acquire(&gresident.lock);
+  gresident_link(pi);
+  release(&gresident.lock);
+}
+
+// Caller holds gresident.lock.
+static void
+gresident_unlink(struct page_info *pi)
+{
+  if(pi->gprev)
+    pi->gprev->gnext = pi->gnext;
+  else
+    gresident.head = pi->gnext;
+  if(pi->gnext)
+    pi->gnext->gprev = pi->gprev;
+  else
+    gresident.tail = pi->gprev;
+  pi->gnext = pi->gprev = 0;
+  gresident.n--;
+}
+
+static void
+gresident_remove(struct page_info *pi)
+{
+  acquire(&gresident.lock);
+  gresident_unlink(pi);
+  release(&gresident.lock);
+}
+
+// Append a resident page to the tail of the FIFO queue.
+static void
+fifo_push(struct proc *p, struct page_info *pi)
+{
+  pi->next = 0;
+  pi->prev = p->fifo_tail;
+  if(p->fifo_tail)
+    p->fifo_tail->next = pi;
+  else
+    p->fifo_head = pi;
+  p->fifo_tail = pi;
+}
+
+// Unlink a page from anywhere in the FIFO queue.
+static void
+fifo_remove(struct proc *p, struct page_info *pi)
+{
+  if(pi->prev)
+    pi->prev->next = pi->next;
+  else
+    p->fifo_head = pi->next;
+  if(pi->next)
+    pi->next->prev = pi->prev;
+  else
+    p->fifo_tail = pi->prev;
+  pi->next = pi->prev = 0;
+}
+
+// Put a page on its owner's resident queue and the global list.
+static void
+resident_add(struct proc *p, struct page_info *pi)
+{
+  pi->resident = 1;
+  p->nresident++;
+  fifo_push(p, pi);
+  gresident_push(pi);
+}
+
+// Take a page off both resident lists.
+static void
+resident_del(struct proc *p, struct page_info *pi)
+{
+  pi->resident = 0;
+  p->nresident--;
+  fifo_remove(p, pi);
+  gresident_remove(pi);
+}
+
+// Make a resident page the oldest on both resident lists, so that
+// FIFO evicts it next, and clear its PTE_A so that CLOCK does too.
+static void
+resident_demote(struct proc *p, struct page_info *pi)
+{
+  pte_t *pte;
+  int mega;
+
+  fifo_remove(p, pi);
+  pi->next = p->fifo_head;
+  if(p->fifo_head)
+    p->fifo_head->prev = pi;
+  else
+    p->fifo_tail = pi;
+  p->fifo_head = pi;
+
+  acquire(&gresident.lock);
+  gresident_unlink(pi);
+  pi->gnext = gresident.head;
+  if(gresident.head)
+    gresident.head->gprev = pi;
+  else
+    gresident.tail = pi;
+  gresident.head = pi;
+  gresident.n++;
+  release(&gresident.lock);
+
+  pi->accessed = 0;
+  if((pte = walkleaf(p->pagetable, pi->va, &mega)) != 0 && !mega) {
+    *pte &= ~PTE_A;
+    sfence_vma();
+  }
+}
+
+// Make a resident page the youngest on both resident lists, so that
+// a victim that could not be evicted now isn't picked again at once.
+static void
+resident_skip(struct proc *p, struct page_info *pi)
+{
+  fifo_remove(p, pi);
+  fifo_push(p, pi);
+  acquire(&gresident.lock);
+  gresident_unlink(pi);
+  gresident_link(pi);
+  release(&gresident.lock);
+}
+
+static uint64 alloc_user_page(struct proc *);
+
+// Iterate over all of p's page_info entries, used or not:
+// for(pi = page_info_first(p); pi; pi = page_info_next(pi))
+struct page_info*
+page_info_first(struct proc *p)
+{
+  return p->page_chunks ? p->page_chunks->pi : 0;
+}
+
 struct page_info*
-add_page_info(struct proc *p, uint64 va)
+page_info_next(struct page_info *pi)
 {
-  if(p->npages >= MAX_SWAP_PAGES)
-    return 0;
+  struct page_chunk *c = (struct page_chunk*)PGROUNDDOWN((uint64)pi);
+
+  if(pi + 1 < &c->pi[PAGE_CHUNK_N])
+    return pi + 1;
+  return c->next ? c->next->pi : 0;
+}
+
+// Append a fresh chunk to p's metadata and put its entries on
+// the free list.
+static void
+page_chunk_add(struct proc *p, struct page_chunk *c)
+{
+  struct page_chunk **pp;
+
+  for(pp = &p->page_chunks; *pp; pp = &(*pp)->next)
+    ;
+  c->next = 0;
+  *pp = c;
+  for(int i = PAGE_CHUNK_N - 1; i >= 0; i--) {
+    c->pi[i].used = 0;
+    c->pi[i].next = p->page_free;
+    p->page_free = &c->pi[i];
+  }
+}
+
+// Start tracking a page that is not resident. Grows p's page
+// metadata by a page when it is full, evicting if need be.
+static struct page_info*
+track_page(struct proc *p, uint64 va)
+{
+  struct page_chunk *c;
+
+  if(p->page_free == 0) {
+    if((c = (struct page_chunk*)alloc_user_page(p)) == 0)
+      return 0;
+    page_chunk_add(p, c);
+  }
+
+  struct page_info *pi = p->page_free;
+  p->page_free = pi->next;
   
   va = PGROUNDDOWN(va);
-  struct page_info *pi = &p->pages[p->npages];
   pi->va = va;
   pi->seq = p->next_seq++;
   pi->dirty = 0;
   pi->swapped = 0;
   pi->swap_offset = 0;
-  pi->resident = 1;
+  pi->has_slot = 0;
+  pi->used = 1;
+  pi->readahead = 0;
+  pi->zero = 0;
+  pi->accessed = 0;
+  pi->owner = p;
+  page_hash_insert(p, pi);
   p->npages++;
   return pi;
 }
 
-// Allocate a swap slot
-// Returns slot number on success, -1 on failure
-int
-alloc_swap_slot(struct proc *p)
+// Add a new resident page to tracking
+struct page_info*
+add_page_info(struct proc *p, uint64 va)
 {
-  // Check if we've reached the maximum
-  if(p->nswap_slots >= MAX_SWAP_PAGES) {
-    return -1;
-  }
-  
-  // Find the first free slot in the bitmap
-  for(int i = 0; i < MAX_SWAP_PAGES; i++) {
-    int word_idx = i / 32;
-    int bit_idx = i % 32;
-    
-    if((p->swap_slots[word_idx] & (1 << bit_idx)) == 0) {
-      // Found a free slot
-      p->swap_slots[word_idx] |= (1 << bit_idx);
-      p->nswap_slots++;
-      return i;
-    }
-  }
-  
-  return -1;
+  struct page_info *pi = track_page(p, va);
+  if(pi)
+    resident_add(p, pi);
+  return pi;
 }
 
-// Free a swap slot
+// Stop tracking a page and return its slot to the free list.
+// Other page_info pointers stay valid.
 void
-free_swap_slot(struct proc *p, int slot)
+remove_page_info(struct proc *p, struct page_info *pi)
 {
-  if(slot < 0 || slot >= MAX_SWAP_PAGES)
-    return;
-    
-  int word_idx = slot / 32;
-  int bit_idx = slot % 32;
-  
-  // Clear the bit
-  if(p->swap_slots[word_idx] & (1 << bit_idx)) {
-    p->swap_slots[word_idx] &= ~(1 << bit_idx);
-    p->nswap_slots--;
-  }
+  page_hash_remove(p, pi);
+  if(pi->resident)
+    resident_del(p, pi);
+  if(pi->has_slot)
+    free_swap_slot(pi->swap_offset);
+  pi->used = 0;
+  pi->next = p->page_free;
+  p->page_free = pi;
+  p->npages--;
 }
 
-// Create swap file for process
-int
-create_swapfile(struct proc *p)
-{
-  char path[32];
-  // Format: /pgswpXXXXX where XXXXX is PID
-  path[0] = '/';
-  path[1] = 'p';
-  path[2] = 'g';
-  path[3] = 's';
-  path[4] = 'w';
-  path[5] = 'p';
-  
-  // Convert PID to string (5 digits)
-  int pid = p->pid;
-  for(int i = 10; i >= 6; i--) {
-    path[i] = '0' + (pid % 10);
-    pid /= 10;
-  }
-  path[11] = 0;
-  
-  begin_op();
-  struct inode *ip = create(path, T_FILE, 0, 0);
-  if(ip == 0) {
-    end_op();
-    return -1;
-  }
-  
-  // Allocate a file structure
-  struct file *f = filealloc();
-  if(f == 0) {
-    iunlockput(ip);
-    end_op();
-    return -1;
+// Forget all tracked pages of a process that was never on the
+// global list, or has already left it (see drop_page_info), and
+// free its page metadata.
+void
+clear_page_info(struct proc *p)
+{
+  struct page_chunk *c;
+
+  p->npages = 0;
+  p->nresident = 0;
+  memset(p->page_hash, 0, sizeof(p->page_hash));
+  p->fifo_head = p->fifo_tail = 0;
+  p->page_free = 0;
+  while((c = p->page_chunks) != 0) {
+    p->page_chunks = c->next;
+    kfree(c);
   }
-  
-  f->type = FD_INODE;
-  f->off = 0;
-  f->ip = ip;
-  f->readable = 1;
-  f->writable = 1;
-  iunlock(ip);
-  end_op();
-  
-  p->swapfile = f;
-  return 0;
 }
 
-// Delete swap file for process
+// Forget all tracked pages, taking resident ones off the global
+// list and releasing swap slots first. p->vmlock must be held.
 void
-delete_swapfile(struct proc *p)
+drop_page_info(struct proc *p)
 {
-  if(p->swapfile == 0)
-    return;
-  
-  // Log swap cleanup with number of slots reclaimed
-  int slots_reclaimed = p->nswap_slots;
-  printf("[pid %d] SWAPCLEANUP freed_slots=%d\n", p->pid, slots_reclaimed);
-  
-  // Close the file
-  fileclose(p->swapfile);
-  p->swapfile = 0;
-  
-  // Clear swap slot bitmap
-  for(int i = 0; i < MAX_SWAP_PAGES / 32; i++) {
-    p->swap_slots[i] = 0;
-  }
-  p->nswap_slots = 0;
-  
-  // Note: We don't explicitly delete the swap file here to avoid
-  // locking issues. The file will remain on disk but that's OK for now.
-  // In a production system, we'd mark it for cleanup by a background task.
+  struct page_info *pi;
+
+  for(pi = p->fifo_head; pi; pi = pi->next)
+    gresident_remove(pi);
+  for(pi = page_info_first(p); pi; pi = page_info_next(pi))
+    if(pi->used && pi->has_slot)
+      free_swap_slot(pi->swap_offset);
+  clear_page_info(p);
 }
 
-// Evict a page using FIFO policy
-// Evicts ONLY from this process's own resident set (per-process replacement)
-uint64
-evict_page(struct proc *p)
+// Free p's page_info chunks that track no page any more, and
+// rebuild the free list from the others. Entries in use keep
+// their places.
+static void
+page_chunk_trim(struct proc *p)
 {
-  // Find the page with the lowest sequence number (oldest) from resident set
-  // Note: Using uint64 for sequence numbers means wraparound occurs after 2^64
-  // allocations, which is practically impossible in xv6's lifetime
-  struct page_info *victim = 0;
-  uint64 min_seq = ~0ULL;
-  
-  for(int i = 0; i < p->npages; i++) {
-    if(p->pages[i].resident && p->pages[i].seq < min_seq) {
-      min_seq = p->pages[i].seq;
-      victim = &p->pages[i];
+  struct page_chunk *c, **pp;
+  int i, nchunks = 0;
+
+  for(c = p->page_chunks; c; c = c->next)
+    nchunks++;
+  if(p->npages + PAGE_CHUNK_N > nchunks * PAGE_CHUNK_N)
+    return;
+
+  p->page_free = 0;
+  for(pp = &p->page_chunks; (c = *pp) != 0; ) {
+    for(i = 0; i < PAGE_CHUNK_N && !c->pi[i].used; i++)
+      ;
+    if(i == PAGE_CHUNK_N) {
+      *pp = c->next;
+      kfree(c);
+      continue;
     }
+    for(i = PAGE_CHUNK_N - 1; i >= 0; i--) {
+      if(!c->pi[i].used) {
+        c->pi[i].next = p->page_free;
+        p->page_free = &c->pi[i];
+      }
+    }
+    pp = &c->next;
   }
-  
-  if(victim == 0)
+}
+
+// Split a megapage that maps va but doesn't start there.
+// Returns -1 if out of memory.
+static int
+megasplit_at(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  int mega;
+
+  if(va % MEGASIZE == 0 || va >= MAXVA)
+    return 0;
+  if((pte = walkleaf(pagetable, va, &mega)) != 0 && mega)
+    return megasplit(pte);
+  return 0;
+}
+
+// Unmap [va, end) of p in one pass over the page table: free
+// resident frames, drop the range's page_info entries and their
+// swap slots, free page-table pages left empty and metadata chunks
+// left unused. va and end must be page-aligned. Megapages only
+// partly inside the range are split first; returns -1, with
+// nothing unmapped, if that runs out of memory.
+// p->vmlock must be held.
+int
+unmap_range(struct proc *p, uint64 va, uint64 end)
+{
+  struct page_info *pi;
+
+  if(va >= end)
+    return 0;
+  if(megasplit_at(p->pagetable, va) < 0 || megasplit_at(p->pagetable, end) < 0)
+    return -1;
+  // Look the pages up one by one, or scan the metadata if the
+  // range is larger than it.
+  if((end - va) / PGSIZE <= p->npages) {
+    for(uint64 a = va; a < end; a += PGSIZE)
+      if((pi = find_page_info(p, a)) != 0)
+        remove_page_info(p, pi);
+  } else {
+    for(pi = page_info_first(p); pi; pi = page_info_next(pi))
+      if(pi->used && pi->va >= va && pi->va < end)
+        remove_page_info(p, pi);
+  }
+  unmap_level(p->pagetable, 2, 0, va, end);
+  sfence_vma();
+  page_chunk_trim(p);
+  return 0;
+}
+
+// Translate a pointer to one of p's page_info entries to the
+// same entry of the child's copy (see copy_page_info).
+static struct page_info*
+page_info_reloc(struct page_info *pi)
+{
+  struct page_chunk *c;
+
+  if(pi == 0)
+    return 0;
+  c = (struct page_chunk*)PGROUNDDOWN((uint64)pi);
+  return &c->copy->pi[pi - c->pi];
+}
+
+// Copy the parent's page tracking into a fresh child, which
+// takes a reference to every swap slot the parent uses.
+// The child gets a chunk for each of the parent's, and entries
+// keep their places, so its hash chains, FIFO queue and free
+// list mirror the parent's. Returns -1 if out of memory.
+int
+copy_page_info(struct proc *np, struct proc *p)
+{
+  struct page_chunk *c, *nc, **tail = &np->page_chunks;
+
+  for(c = p->page_chunks; c; c = c->next) {
+    if((nc = kalloc()) == 0) {
+      clear_page_info(np);
+      return -1;
+    }
+    nc->next = 0;
+    *tail = nc;
+    tail = &nc->next;
+    c->copy = nc;
+  }
+
+  acquire(&swaparea.lock);
+  for(c = p->page_chunks; c; c = c->next) {
+    for(int i = 0; i < PAGE_CHUNK_N; i++) {
+      struct page_info *pi = &c->copy->pi[i];
+      *pi = c->pi[i];
+      pi->hnext = page_info_reloc(pi->hnext);
+      pi->next = page_info_reloc(pi->next);
+      pi->prev = page_info_reloc(pi->prev);
+      pi->owner = np;
+      // The slot still matches the page: a resident page is shared
+      // copy-on-write, a swapped one has not been touched.
+      if(pi->used && pi->has_slot)
+        swaparea.slotref[pi->swap_offset]++;
+    }
+  }
+  release(&swaparea.lock);
+  for(int i = 0; i < PAGE_HASH_SIZE; i++)
+    np->page_hash[i] = page_info_reloc(p->page_hash[i]);
+  np->page_free = page_info_reloc(p->page_free);
+  np->fifo_head = page_info_reloc(p->fifo_head);
+  np->fifo_tail = page_info_reloc(p->fifo_tail);
+  np->npages = p->npages;
+  np->nresident = p->nresident;
+  np->next_seq = p->next_seq;
+  for(struct page_info *pi = np->fifo_head; pi; pi = pi->next)
+    gresident_push(pi);
+  return 0;
+}
+
+// Find the swap area: whatever the disk holds beyond the file
+// system. The Makefile appends it to fs.img. Called once the
+// superblock has been read.
+void
+swapinit(void)
+{
+  uint64 blocks = virtio_disk_capacity() / (BSIZE / 512);
+
+  swaparea.start = sb.size;
+  if(blocks > sb.size)
+    swaparea.nslots = (blocks - sb.size) / (PGSIZE / BSIZE);
+  if(swaparea.nslots > SWAPPAGES)
+    swaparea.nslots = SWAPPAGES;
+  for(int i = swaparea.nslots; i < SWAPWORDS * 64; i++)
+    swaparea.busy[i / 64] |= 1UL << (i % 64);
+  printf("swap: %d pages at block %d\n", swaparea.nslots, swaparea.start);
+}
+
+// Count trailing zeros of x, which must not be 0. Binary search,
+// as the base RISC-V ISA has no instruction for it.
+static int
+ctz64(uint64 x)
+{
+  int n = 0;
+
+  for(int s = 32; s > 0; s /= 2) {
+    if((x & ((1UL << s) - 1)) == 0) {
+      x >>= s;
+      n += s;
+    }
+  }
+  return n;
+}
+
+// Are slots [i, i+n) all free? swaparea.lock must be held.
+static int
+swap_run_free(int i, int n)
+{
+  if(i < 0 || i + n > swaparea.nslots)
+    return 0;
+  while(n > 0) {
+    int b = i % 64, k = 64 - b < n ? 64 - b : n;
+    uint64 mask = (k == 64 ? ~0UL : (1UL << k) - 1) << b;
+    if(swaparea.busy[i / 64] & mask)
+      return 0;
+    i += k;
+    n -= k;
+  }
+  return 1;
+}
+
+// First run of n free slots at or after slot from, or -1. Full
+// words are skipped whole. swaparea.lock must be held.
+static int
+swap_find_run(int from, int n)
+{
+  int i = from;
+
+  while(i + n <= swaparea.nslots) {
+    uint64 free = ~swaparea.busy[i / 64] >> (i % 64);
+    if(free == 0) {
+      i = (i / 64 + 1) * 64;
+      continue;
+    }
+    i += ctz64(free);
+    if(swap_run_free(i, n))
+      return i;
+    i++;
+  }
+  return -1;
+}
+
+// Allocate n consecutive swap slots, starting at hint if those are
+// free, else at the first run after the last allocation, so that
+// successive swap-outs go to successive disk blocks.
+// Returns the first slot on success, -1 if there is no such run.
+static int
+alloc_swap_run(int n, int hint)
+{
+  int slot = -1;
+
+  acquire(&swaparea.lock);
+  if(swaparea.nused + n <= swaparea.nslots) {
+    if(swap_run_free(hint, n))
+      slot = hint;
+    else if((slot = swap_find_run(swaparea.next, n)) < 0)
+      slot = swap_find_run(0, n);
+  }
+  if(slot >= 0) {
+    for(int i = slot; i < slot + n; i++) {
+      swaparea.slotref[i] = 1;
+      swaparea.busy[i / 64] |= 1UL << (i % 64);
+    }
+    swaparea.nused += n;
+    swaparea.next = slot + n;
+  }
+  release(&swaparea.lock);
+  return slot;
+}
+
+// Allocate a swap slot
+// Returns slot number on success, -1 on failure
+int
+alloc_swap_slot(void)
+{
+  return alloc_swap_run(1, -1);
+}
+
+// A slot hint for n pages of q from va on: just after the slot of
+// the page before va, or just before that of the page after them,
+// so that pages next to each other in memory are next to each
+// other in swap, and swap-in readahead finds them.
+static int
+swap_hint(struct proc *q, uint64 va, int n)
+{
+  struct page_info *pi;
+
+  if(va >= PGSIZE && (pi = find_page_info(q, va - PGSIZE)) != 0 && pi->has_slot)
+    return pi->swap_offset + 1;
+  if((pi = find_page_info(q, va + n * PGSIZE)) != 0 && pi->has_slot)
+    return pi->swap_offset - n;
+  return -1;
+}
+
+// Drop a page's reference to a swap slot, freeing the slot
+// when no page of any process uses it any more.
+void
+free_swap_slot(int slot)
+{
+  if(slot < 0 || slot >= swaparea.nslots)
+    return;
+
+  acquire(&swaparea.lock);
+  if(swaparea.slotref[slot] > 0 && --swaparea.slotref[slot] == 0) {
+    swaparea.busy[slot / 64] &= ~(1UL << (slot % 64));
+    swaparea.nused--;
+    zswap_drop(slot);
+  }
+  release(&swaparea.lock);
+}
+
+// Take one more reference to slot, so that it is neither freed
+// nor reused until free_swap_slot(). Returns -1 if it is free.
+int
+swap_hold(int slot)
+{
+  int r = -1;
+
+  if(slot < 0 || slot >= swaparea.nslots)
+    return -1;
+  acquire(&swaparea.lock);
+  if(swaparea.slotref[slot] > 0) {
+    swaparea.slotref[slot]++;
+    r = 0;
+  }
+  release(&swaparea.lock);
+  return r;
+}
+
+// Write the page at pa to slot on disk, bypassing the compressed
+// pool, for zswap_shrink().
+void
+swap_writeslot(int slot, uint64 pa)
+{
+  virtio_disk_rwpages(swaparea.start + slot * (PGSIZE / BSIZE), &pa, 1, 1);
+}
+
+// Read or write n pages at consecutive swap slots. Pages that the
+// compressed pool holds, or takes, skip the disk; the others are
+// read or written in runs of consecutive slots.
+static void
+swap_rw(int slot, uint64 *pa, int n, int write)
+{
+  int i = 0, j;
+
+  while(i < n) {
+    for(j = i; j < n; j++) {
+      if((write ? zswap_store(slot + j, pa[j]) : zswap_load(slot + j, pa[j])) == 0)
+        break;
+    }
+    if(j > i)
+      virtio_disk_rwpages(swaparea.start + (slot + i) * (PGSIZE / BSIZE), pa + i, j - i, write);
+    i = j + 1;
+  }
+}
+
+// Release p's swap slots when it exits.
+// p->vmlock must be held.
+void
+release_swap(struct proc *p)
+{
+  struct page_info *pi;
+  int slots_reclaimed = 0;
+
+  for(pi = page_info_first(p); pi; pi = page_info_next(pi)) {
+    if(pi->used && pi->has_slot) {
+      free_swap_slot(pi->swap_offset);
+      pi->has_slot = 0;
+      slots_reclaimed++;
+    }
+  }
+
+  // Log swap cleanup with number of slots reclaimed
+  trace(TR_SWAPCLEANUP, p->pid, 0, 0, slots_reclaimed);
+}
+
+// p's access hint (MADV_*) for the page at va, see madvise().
+static int
+madv_at(struct proc *p, uint64 va)
+{
+  if(va >= p->madv_lo && va < p->madv_hi)
+    return p->madv;
+  return MADV_NORMAL;
+}
+
+// Settle a readahead page: it was used (hit) or is being evicted
+// without having been used (waste). Hits widen p's readahead
+// window by one page, waste halves it.
+static void
+ra_settle(struct proc *p, struct page_info *pi, int hit)
+{
+  pi->readahead = 0;
+  if(hit && p->ra_window < SWAPRA_MAX)
+    p->ra_window++;
+  else if(!hit)
+    p->ra_window /= 2;
+
+  acquire(&rastat.lock);
+  if(hit)
+    rastat.st.hits++;
+  else
+    rastat.st.waste++;
+  release(&rastat.lock);
+}
+
+// Is a resident page referenced since its PTE_A bit was last
+// cleared? Clears the bit, so the page gets one more chance.
+// wss_sample() clears it too, but leaves pi->accessed set.
+// A page in a megapage shares the level-1 leaf's bit, which is
+// read and cleared there rather than splitting the megapage.
+static int
+page_referenced(struct proc *q, struct page_info *pi)
+{
+  int mega;
+  pte_t *pte = walkleaf(q->pagetable, pi->va, &mega);
+  int accessed = pi->accessed;
+
+  pi->accessed = 0;
+  if(pte == 0 || (*pte & PTE_V) == 0 || ((*pte & PTE_A) == 0 && !accessed))
     return 0;
+  *pte &= ~PTE_A;
+  if(pi->readahead)
+    ra_settle(q, pi, 1);
+  return 1;
+}
+
+// CLOCK (second chance): walk the resident queue from its head.
+// A page whose PTE_A bit is set has been used since it was last
+// looked at, so clear the bit and move it to the tail; the first
+// page found with PTE_A clear is the victim. Clearing PTE_A needs
+// a TLB flush, or a cached translation would keep the hardware
+// from setting the bit again.
+static struct page_info*
+clock_victim(struct proc *p)
+{
+  struct page_info *pi;
+  int cleared = 0;
+
+  // After one lap every bit is clear, so two laps always suffice.
+  for(int n = 0; n < 2 * p->npages && (pi = p->fifo_head) != 0; n++) {
+    if(!page_referenced(p, pi))
+      break;
+    cleared = 1;
+    fifo_remove(p, pi);
+    fifo_push(p, pi);
+  }
+  if(cleared)
+    sfence_vma();
+  return p->fifo_head;
+}
+
+// Global replacement: pick the oldest page in the system whose
+// owner's memory can be locked without waiting.
+// Under CLOCK, referenced pages are moved to the tail instead.
+// Owners that are running on another hart are passed over.
+// Returns with victim->owner->vmlock held if the owner is not p.
+// Clearing PTE_A of a process running on another hart cannot
+// flush that hart's TLB; at worst the page looks colder than it is.
+static struct page_info*
+global_victim(struct proc *p)
+{
+  struct page_info *pi, *next;
+  struct proc *q;
+  int cleared = 0;
+
+  acquire(&gresident.lock);
+  int n = 2 * gresident.n;
+  for(pi = gresident.head; pi && n > 0; pi = next, n--) {
+    next = pi->gnext;
+    q = pi->owner;
+    // q->state and q->incopy are read without q->lock as hints
+    // only; detach_page() checks them again under the lock.
+    if(q != p && (q->state == RUNNING || q->incopy || !tryacquiresleep(&q->vmlock)))
+      continue;
+    if(p->pagealgo == PAGEALGO_CLOCK && page_referenced(q, pi)) {
+      cleared = 1;
+      gresident_unlink(pi);
+      gresident_link(pi);
+      if(next == 0)
+        next = pi;
+      if(q != p)
+        releasesleep(&q->vmlock);
+      continue;
+    }
+    break;
+  }
+  if(n == 0)
+    pi = 0;
+  release(&gresident.lock);
+  if(cleared)
+    sfence_vma();
+  return pi;
+}
+
+// Unmap a resident page, folding its hardware dirty bit into
+// pi->dirty. Returns the old PTE, or 0 if the page isn't mapped.
+// If q is another process it must not be running: its hart's TLB
+// could still hold the translation. Nor may it be preempted inside
+// copyin()/copyout(), which use a physical address they looked up
+// without q->vmlock. Once the PTE is cleared, a later access by q
+// faults and waits for q->vmlock.
+static pte_t
+detach_page(struct proc *q, struct page_info *pi)
+{
+  pte_t *pte, old = 0;
+
+  if(q != myproc())
+    acquire(&q->lock);
+  pte = walk(q->pagetable, pi->va, 0);
+  if(pte && (*pte & PTE_V) &&
+     (q == myproc() || (q->state != RUNNING && !q->incopy))) {
+    old = *pte;
+    if(old & PTE_D)
+      pi->dirty = 1;
+    *pte = 0;
+    sfence_vma();
+  }
+  if(q != myproc())
+    release(&q->lock);
+  return old;
+}
+
+// Detached victim pages whose contents must be written to swap.
+// All belong to one owner and go to disk in one request.
+struct cluster {
+  int n;
+  struct page_info *pi[SWAPCLUSTER];
+  pte_t pte[SWAPCLUSTER];      // PTE before detaching
+};
+
+// A page of a shared mapping never goes to swap: a forked relative
+// sharing its frame would keep the old one and stop seeing q's
+// writes, and the file would miss the data. Such a page stays
+// resident while another process maps its frame, or while it is
+// dirty and can't be written back now: see mmap.c.
+static int
+mmap_pinned(struct proc *q, struct page_info *pi)
+{
+  int mega;
+  pte_t *pte = walkleaf(q->pagetable, pi->va, &mega);
+
+  if(pte == 0 || (*pte & PTE_V) == 0)
+    return 0;
+  if(krefcount((void*)PTE2PA(*pte)) > 1)
+    return 1;
+  return page_is_dirty(q, pi) && (q != myproc() || q->fsfault);
+}
+
+// Detach victim page pi of process q. Discard it or keep its slot
+// and free its frame now, or queue it on c if it must be written.
+// The caller holds q->vmlock. Returns 0 if pi could not be detached.
+static int
+evict_victim(struct proc *q, struct page_info *pi, int algo, struct cluster *c)
+{
+  uint64 va = pi->va;
+  struct mmap_region *r = mmap_find(q, va);
   
-  uint64 va = victim->va;
-  uint64 victim_seq = victim->seq;
+  if(r && r->flags == MAP_SHARED && mmap_pinned(q, pi))
+    return 0;
   
   // Log the victim selection
-  printf("[pid %d] VICTIM va=0x%lx seq=%d algo=FIFO\n", p->pid, va, (int)victim_seq);
+  trace(TR_VICTIM, q->pid, va, algo, (int)pi->seq);
   
-  pte_t *pte = walk(p->pagetable, va, 0);
-  if(pte == 0 || (*pte & PTE_V) == 0)
+  pte_t old = detach_page(q, pi);
+  if(old == 0)
     return 0;
+  if(pi->readahead)
+    ra_settle(q, pi, (old & PTE_A) != 0 || pi->accessed);
   
-  uint64 pa = PTE2PA(*pte);
+  uint64 pa = PTE2PA(old);
   
   // Check if page has a valid backing store (can be reloaded from executable)
   int has_backing_store = 0;
-  for(int i = 0; i < p->nsegments; i++) {
-    if(va >= p->segments[i].vaddr && va < p->segments[i].vaddr + p->segments[i].memsz) {
+  for(int i = 0; i < q->nsegments; i++) {
+    if(va >= q->segments[i].vaddr && va < q->segments[i].vaddr + q->segments[i].memsz) {
       // Page is in text/data segment and can be reloaded from executable
-      uint64 offset_in_seg = va - p->segments[i].vaddr;
-      if(offset_in_seg < p->segments[i].filesz) {
+      uint64 offset_in_seg = va - q->segments[i].vaddr;
+      if(offset_in_seg < q->segments[i].filesz) {
         has_backing_store = 1;
       }
       break;
     }
   }
   
-  // Determine if we need to swap out or can discard
-  int should_swap = 0;
-  
-  // If dirty OR no backing store, must write to swap
-  if(victim->dirty || !has_backing_store) {
-    should_swap = 1;
+  // A mapped file backs its pages too.
+  if(r)
+    has_backing_store = 1;
+  
+  int dirty = pi->dirty;
+  
+  // A written page of a shared mapping goes back to its file;
+  // mmap_pinned() has checked that q can write it now.
+  if(r && r->flags == MAP_SHARED && dirty) {
+    resident_del(q, pi);
+    mmap_writepage(r, va, pa);
+    trace(TR_WRITEBACK, q->pid, va, 0, 0);
+    trace(TR_EVICT, q->pid, va, dirty, 0);
+    pstat_evict(q, 0);
+    remove_page_info(q, pi);
+    kfree((void*)pa);
+    return 1;
   }
   
-  if(should_swap) {
-    // Write page to swap file
-    if(swapout_page(p, va) < 0) {
-      // Swap is full - terminate process
-      printf("[pid %d] SWAPFULL\n", p->pid);
-      printf("[pid %d] KILL swap-exhausted\n", p->pid);
-      p->killed = 1;
-      return 0;
-    }
+  // If dirty OR no backing store, must write to swap.
+  // A page that already owns a slot lives in swap, not in the executable.
+  if(dirty || !has_backing_store || pi->has_slot) {
+    resident_del(q, pi);
     
-    victim->swapped = 1;
-    victim->resident = 0;
-    printf("[pid %d] EVICT va=0x%lx state=%s\n", p->pid, va, victim->dirty ? "dirty" : "clean");
-  } else {
-    // Clean page with backing store - can be discarded
-    printf("[pid %d] EVICT va=0x%lx state=clean\n", p->pid, va);
-    printf("[pid %d] DISCARD va=0x%lx\n", p->pid, va);
+    // A page swapped in earlier and not written since is
+    // still intact in its slot; skip the disk write.
+    if(pi->has_slot && !dirty) {
+      trace(TR_SWAPKEEP, q->pid, va, 0, pi->swap_offset);
+      pi->swapped = 1;
+      trace(TR_EVICT, q->pid, va, 0, 0);
+      pstat_evict(q, 0);
+      kfree((void*)pa);
+      return 1;
+    }
     
-    // Remove page_info entry since page can be reloaded from executable
-    // Shift all subsequent entries down
-    int victim_idx = victim - p->pages;
-    for(int i = victim_idx; i < p->npages - 1; i++) {
-      p->pages[i] = p->pages[i + 1];
+    // The old slot may be shared with a forked relative, and the
+    // cluster is written to fresh consecutive slots anyway.
+    if(pi->has_slot) {
+      free_swap_slot(pi->swap_offset);
+      pi->has_slot = 0;
     }
-    p->npages--;
+    c->pi[c->n] = pi;
+    c->pte[c->n] = old;
+    c->n++;
+    return 1;
+  }
+  
+  // Clean page with backing store - can be discarded. If the
+  // page cache shares it, this only drops q's mapping.
+  trace(TR_EVICT, q->pid, va, 0, 0);
+  trace(TR_DISCARD, q->pid, va, 0, 0);
+  pstat_evict(q, 1);
+  
+  // Remove page_info entry since page can be reloaded from executable
+  remove_page_info(q, pi);
+  
+  // Free the physical page
+  kfree((void*)pa);
+  
+  return 1;
+}
+
+// A queued page now lives in swap slot; free its frame.
+static void
+swapout_done(struct proc *q, struct page_info *pi, pte_t old, int slot)
+{
+  pi->swap_offset = slot;
+  pi->has_slot = 1;
+  pi->swapped = 1;
+  trace(TR_SWAPOUT, q->pid, pi->va, 0, slot);
+  trace(TR_EVICT, q->pid, pi->va, pi->dirty, 0);
+  pstat_evict(q, 0);
+  kfree((void*)PTE2PA(old));
+}
+
+// Write the pages queued on c to consecutive swap slots with a
+// single disk request and free their frames. If swap is too
+// fragmented, fall back to one request per page. A page that gets
+// no slot at all is mapped again; swap is full, so terminate q if
+// it is the process that faulted. Returns the number swapped out.
+// The pages are sorted by address first, so that slots follow
+// addresses.
+static int
+swapout_cluster(struct proc *q, struct cluster *c)
+{
+  uint64 pa[SWAPCLUSTER], t0;
+  int i, j, slot, n = 0;
+
+  if(c->n == 0)
+    return 0;
+
+  for(i = 1; i < c->n; i++) {
+    struct page_info *pi = c->pi[i];
+    pte_t pte = c->pte[i];
+    for(j = i; j > 0 && c->pi[j-1]->va > pi->va; j--) {
+      c->pi[j] = c->pi[j-1];
+      c->pte[j] = c->pte[j-1];
+    }
+    c->pi[j] = pi;
+    c->pte[j] = pte;
+  }
+
+  if((slot = alloc_swap_run(c->n, swap_hint(q, c->pi[0]->va, c->n))) >= 0) {
+    for(i = 0; i < c->n; i++)
+      pa[i] = PTE2PA(c->pte[i]);
+    t0 = r_time();
+    swap_rw(slot, pa, c->n, 1);
+    pstat_time(q, LAT_SWAPOUT, t0);
+    pstat_swap(q, c->n, 1);
+    for(i = 0; i < c->n; i++)
+      swapout_done(q, c->pi[i], c->pte[i], slot + i);
+    n = c->n;
+    c->n = 0;
+    return n;
+  }
+
+  for(i = 0; i < c->n; i++) {
+    struct page_info *pi = c->pi[i];
+    if((slot = alloc_swap_run(1, swap_hint(q, pi->va, 1))) < 0) {
+      // Put the page back.
+      printf("[pid %d] SWAPFULL\n", q->pid);
+      *walk(q->pagetable, pi->va, 0) = c->pte[i];
+      resident_add(q, pi);
+      if(q == myproc()) {
+        printf("[pid %d] KILL swap-exhausted\n", q->pid);
+        q->killed = 1;
+      }
+      continue;
+    }
+    pa[0] = PTE2PA(c->pte[i]);
+    t0 = r_time();
+    swap_rw(slot, pa, 1, 1);
+    pstat_time(q, LAT_SWAPOUT, t0);
+    pstat_swap(q, 1, 1);
+    swapout_done(q, pi, c->pte[i], slot);
+    n++;
+  }
+  c->n = 0;
+  return n;
+}
+
+// Evict up to swapcluster pages. The first victim follows p's
+// replacement scope (global if asked) and policy; the rest come
+// from the same owner's resident queue, so that their writes can
+// share one disk request. A victim that can't be detached (its
+// owner is running on another hart, or its PTE is gone) is moved
+// to the tail of the lists and the scan goes on until every
+// resident page has been tried. p->vmlock must be held.
+// Returns the number of pages evicted.
+static int
+evict_cluster(struct proc *p, int global)
+{
+  struct cluster c;
+  struct page_info *victim;
+  struct proc *q;
+  int algo = p->pagealgo;
+  int n = 0, tries;
+
+  // The head of the resident queue is the oldest page.
+  // Note: Using uint64 for sequence numbers means wraparound occurs after 2^64
+  // allocations, which is practically impossible in xv6's lifetime
+  c.n = 0;
+  for(tries = global ? gresident.n : p->nresident; ; tries--) {
+    if(global)
+      victim = global_victim(p);
+    else if(p->pagealgo == PAGEALGO_CLOCK)
+      victim = clock_victim(p);
+    else
+      victim = p->fifo_head;
+    if(victim == 0)
+      return 0;
+    q = victim->owner;
+    if(evict_victim(q, victim, algo, &c))
+      break;
+    resident_skip(q, victim);
+    if(q != p)
+      releasesleep(&q->vmlock);
+    if(tries <= 1)
+      return 0;
+  }
+
+  n = 1;
+  for(tries = q->nresident; n < swapcluster && tries > 0; tries--) {
+    if(p->pagealgo == PAGEALGO_CLOCK)
+      victim = clock_victim(q);
+    else
+      victim = q->fifo_head;
+    if(victim == 0)
+      break;
+    if(evict_victim(q, victim, algo, &c))
+      n++;
+    else
+      resident_skip(q, victim);
+  }
+  n -= c.n;
+  n += swapout_cluster(q, &c);
+  if(q != p)
+    releasesleep(&q->vmlock);
+  return n;
+}
+
+// Evict pages using the process's replacement policy (FIFO or CLOCK).
+// With pagescope PAGESCOPE_LOCAL only p's own resident set is
+// considered; with PAGESCOPE_GLOBAL any process's page may go.
+// p->vmlock must be held. Returns the number of pages evicted.
+int
+evict_page(struct proc *p)
+{
+  int n = evict_cluster(p, pagescope == PAGESCOPE_GLOBAL);
+
+  if(n) {
+    acquire(&pageout.lock);
+    pageout.st.direct += n;
+    release(&pageout.lock);
+  }
+  return n;
+}
+
+// Page-out daemon. Faulting processes kick it when free memory
+// drops below the low watermark; it then evicts the oldest pages
+// system-wide until the high watermark is reached, so that a fault
+// rarely has to wait for a swap write. The MEMFULL path in
+// vmfault() remains as a fallback. The daemon takes pages from any
+// process whatever pagescope says; detach_page() keeps it off those
+// of processes that are running or inside copyin()/copyout().
+static void
+pageoutd(void)
+{
+  struct proc *p = myproc();
+  int n;
+
+  for(;;) {
+    acquire(&pageout.lock);
+    while(pageout.kicked == 0)
+      sleep(&pageout, &pageout.lock);
+    pageout.kicked = 0;
+    pageout.st.wakeups++;
+    release(&pageout.lock);
+
+    while(kfreecount() < pageout.st.high) {
+      // Unmapped cached executable pages cost nothing to drop.
+      // The compressed swap pool goes to disk only when no
+      // process page can.
+      if((n = pcache_shrink(pageout.st.high - kfreecount())) == 0 &&
+         (n = evict_cluster(p, 1)) == 0)
+        n = zswap_shrink();
+
+      acquire(&pageout.lock);
+      if(n)
+        pageout.st.evicted += n;
+      else
+        pageout.st.stalled++;
+      release(&pageout.lock);
+      // Every owner is busy or running; wait for the next kick
+      // rather than spin.
+      if(n == 0)
+        break;
+    }
+  }
+}
+
+// Is free memory below the daemon's low watermark?
+int
+pageout_lowmem(void)
+{
+  return kfreecount() < pageout.st.low;
+}
+
+// Wake the daemon if free memory is below the low watermark.
+// The caller must not hold a spinlock: wakeup() takes every p->lock.
+static void
+pageout_kick(void)
+{
+  if(kfreecount() >= pageout.st.low)
+    return;
+  acquire(&pageout.lock);
+  pageout.kicked = 1;
+  wakeup(&pageout);
+  release(&pageout.lock);
+}
+
+void
+pageoutinit(void)
+{
+  kthread("pageoutd", pageoutd);
+}
+
+// Set the daemon's watermarks, in pages. low == 0 disables it.
+int
+pageout_setwmark(int low, int high)
+{
+  if(low < 0 || high < low)
+    return -1;
+  acquire(&pageout.lock);
+  pageout.st.low = low;
+  pageout.st.high = high;
+  release(&pageout.lock);
+  return 0;
+}
+
+// Collect each subsystem's statistics into st, for vmstat().
+void
+vmstat(struct vmstat *st)
+{
+  st->free_pages = kfreecount();
+  acquire(&pageout.lock);
+  st->pageout = pageout.st;
+  release(&pageout.lock);
+  acquire(&swaparea.lock);
+  st->swap.slots = swaparea.nslots;
+  st->swap.used = swaparea.nused;
+  release(&swaparea.lock);
+  acquire(&rastat.lock);
+  st->ra = rastat.st;
+  release(&rastat.lock);
+  pcache_getstat(&st->pcache);
+  st->mega = megastat;
+  zswap_getstat(&st->zswap);
+}
+
+// Make room for n more pages in p's resident set under its limit
+// (rsslimit), evicting from that set alone. p->vmlock must be held.
+static void
+rss_enforce(struct proc *p, int n)
+{
+  if(p->rsslimit == 0 || p->nresident + n <= p->rsslimit)
+    return;
+  trace(TR_RSSLIMIT, p->pid, 0, p->nresident, p->rsslimit);
+  while(p->nresident + n > p->rsslimit && evict_cluster(p, 0) > 0)
+    ;
+}
+
+// Allocate a frame for a user page of p, evicting pages until one
+// is free. Evicting a page that is still shared copy-on-write only
+// drops a reference, so one eviction may not be enough. A process
+// at its resident-set limit evicts one of its own pages first.
+static uint64
+alloc_user_page(struct proc *p)
+{
+  uint64 mem;
+
+  rss_enforce(p, 1);
+  if((mem = (uint64)kalloc()) != 0)
+    return mem;
+
+  // Cached executable pages that nobody maps go first.
+  if(pcache_shrink(1) && (mem = (uint64)kalloc()) != 0)
+    return mem;
+
+  // Out of memory - trigger page replacement
+  trace(TR_MEMFULL, p->pid, 0, 0, 0);
+  while(evict_page(p) != 0) {
+    if((mem = (uint64)kalloc()) != 0)
+      return mem;
+  }
+
+  // Nothing left to evict: move the compressed swap pool to disk.
+  while(zswap_shrink()) {
+    if((mem = (uint64)kalloc()) != 0)
+      return mem;
+  }
+  return 0;
+}
+
+// Permissions for a page swapped back in at va: its segment's or
+// mapping's, or read/write for heap and stack.
+static int
+swap_perm(struct proc *p, uint64 va)
+{
+  struct mmap_region *r;
+
+  for(int i = 0; i < p->nsegments; i++) {
+    if(va >= p->segments[i].vaddr && va < p->segments[i].vaddr + p->segments[i].memsz)
+      return p->segments[i].perm | PTE_U | PTE_R;
+  }
+  if((r = mmap_find(p, va)) != 0)
+    return r->perm | PTE_U;
+  return PTE_U | PTE_R | PTE_W;
+}
+
+// A swapped page at va whose slot is slot, for readahead.
+static struct page_info*
+ra_neighbour(struct proc *p, uint64 va, int slot)
+{
+  struct page_info *pi;
+
+  if(va >= MAXVA || slot < 0 || slot >= swaparea.nslots)
+    return 0;
+  pi = find_page_info(p, va);
+  if(pi == 0 || !pi->swapped || !pi->has_slot || pi->swap_offset != slot)
+    return 0;
+  return pi;
+}
+
+// Account for the last readahead batch: pages in it that have been
+// used since count as hits. Unused ones are settled at eviction.
+// Returns 1 if va is next to that batch, i.e. p reads sequentially.
+static int
+ra_check(struct proc *p, uint64 va)
+{
+  struct page_info *pi;
+  pte_t *pte;
+  int mega;
+  uint64 hi = p->ra_lo + p->ra_n * PGSIZE;
+
+  for(uint64 a = p->ra_lo; a < hi; a += PGSIZE) {
+    pi = find_page_info(p, a);
+    if(pi == 0 || !pi->readahead)
+      continue;
+    pte = walkleaf(p->pagetable, a, &mega);
+    if(pi->accessed || (pte && (*pte & PTE_V) && (*pte & PTE_A)))
+      ra_settle(p, pi, 1);
   }
-  
-  // Free the physical page
-  kfree((void*)pa);
-  
-  // Invalidate PTE
-  *pte = 0;
-  
-  return pa;
+  return p->ra_n > 0 && va + PGSIZE >= p->ra_lo && va <= hi;
 }
 
-// Swap out a page to disk
+// Swap in a page from disk, with readahead: swapped pages at
+// neighbouring VAs whose slots adjoin this page's slot are read in
+// the same disk request, up to p->ra_window of them, as long as
+// frames are free without evicting. They are mapped with PTE_A clear
+// and marked readahead, so CLOCK sees them as unused until touched.
 int
-swapout_page(struct proc *p, uint64 va)
+swapin_page(struct proc *p, uint64 va)
 {
+  struct page_info *ra[SWAPRA_MAX + 1], *fwd[SWAPRA_MAX], *back[SWAPRA_MAX];
+  uint64 pa[SWAPRA_MAX + 1], fwdpa[SWAPRA_MAX], backpa[SWAPRA_MAX];
+  int nfwd = 0, nback = 0, n, window, err = 0;
+  uint64 t0 = r_time();
+
   va = PGROUNDDOWN(va);
   
   struct page_info *pi = find_page_info(p, va);
-  if(pi == 0)
+  if(pi == 0 || !pi->swapped)
     return -1;
+
+  if(ra_check(p, va) && p->ra_window == 0)
+    p->ra_window = 1;
   
-  // Create swap file if it doesn't exist
-  if(p->swapfile == 0) {
-    if(create_swapfile(p) < 0) {
-      return -1;
-    }
-  }
-  
-  // Allocate a swap slot if not already allocated
+  // Allocate physical page
+  uint64 mem = alloc_user_page(p);
+  if(mem == 0)
+    return -1;
   int slot = pi->swap_offset;
-  if(!pi->swapped) {
-    slot = alloc_swap_slot(p);
-    if(slot < 0) {
-      // No free swap slots - swap full
-      printf("[pid %d] SWAPFULL\n", p->pid);
-      return -1;
-    }
-    pi->swap_offset = slot;
+
+  // Gather neighbours: ahead of va first, then behind it.
+  // fwd[i] and back[i] are i+1 pages away from va.
+  window = p->ra_window;
+  if(madv_at(p, va) == MADV_SEQUENTIAL)
+    window = SWAPRA_MAX;
+  else if(madv_at(p, va) == MADV_RANDOM)
+    window = 0;
+  if(p->rsslimit && window > p->rsslimit - p->nresident - 1)
+    window = p->rsslimit - p->nresident - 1;
+  while(nfwd + nback < window && kfreecount() > pageout.st.low) {
+    struct page_info *q = ra_neighbour(p, va + (nfwd + 1) * PGSIZE, slot + nfwd + 1);
+    if(q == 0 || (fwdpa[nfwd] = (uint64)kalloc()) == 0)
+      break;
+    fwd[nfwd++] = q;
+  }
+  while(nfwd + nback < window && kfreecount() > pageout.st.low && va >= (nback + 1) * PGSIZE) {
+    struct page_info *q = ra_neighbour(p, va - (nback + 1) * PGSIZE, slot - nback - 1);
+    if(q == 0 || (backpa[nback] = (uint64)kalloc()) == 0)
+      break;
+    back[nback++] = q;
+  }
+
+  // Lay the batch out in slot order.
+  n = 0;
+  for(int i = nback - 1; i >= 0; i--) {
+    ra[n] = back[i];
+    pa[n++] = backpa[i];
+  }
+  ra[n] = pi;
+  pa[n++] = mem;
+  for(int i = 0; i < nfwd; i++) {
+    ra[n] = fwd[i];
+    pa[n++] = fwdpa[i];
   }
   
-  // Get the physical address
-  pte_t *pte = walk(p->pagetable, va, 0);
-  if(pte == 0 || (*pte & PTE_V) == 0)
-    return -1;
-  uint64 pa = PTE2PA(*pte);
-  
-  // Write to swap file
-  begin_op();
-  ilock(p->swapfile->ip);
+  // Read the pages from their slots in the swap area
+  swap_rw(slot - nback, pa, n, 0);
+  pstat_swap(p, n, 0);
   
-  // Write page to swap file at offset (slot * PGSIZE)
-  int n = writei(p->swapfile->ip, 0, pa, slot * PGSIZE, PGSIZE);
+  trace(TR_SWAPIN, p->pid, va, 0, slot);
   
-  iunlock(p->swapfile->ip);
-  end_op();
+  for(int i = 0; i < n; i++) {
+    struct page_info *q = ra[i];
+
+    // Map the page
+    if(mappages(p->pagetable, q->va, PGSIZE, pa[i], swap_perm(p, q->va)) != 0) {
+      kfree((void*)pa[i]);
+      if(q == pi)
+        err = -1;
+      continue;
+    }
   
-  if(n != PGSIZE) {
-    return -1;
+    // Keep the swap slot: until the page is written again (PTE_D),
+    // the slot still holds its contents and eviction need not rewrite it.
+    q->seq = p->next_seq++;
+    q->dirty = 0;
+    q->swapped = 0;  // No longer swapped
+    q->readahead = (q != pi);
+    resident_add(p, q);
+    if(q->readahead)
+      trace(TR_READAHEAD, p->pid, q->va, 0, q->swap_offset);
+  }
+  p->ra_lo = va - nback * PGSIZE;
+  p->ra_n = n;
+
+  if(n > 1) {
+    acquire(&rastat.lock);
+    rastat.st.readahead += n - 1;
+    release(&rastat.lock);
   }
+  pstat_time(p, LAT_SWAPIN, t0);
+  
+  if(err)
+    return err;
+  trace(TR_RESIDENT, p->pid, va, 0, (int)pi->seq);
   
-  printf("[pid %d] SWAPOUT va=0x%lx slot=%d\n", p->pid, va, slot);
   return 0;
 }
 
-// Swap in a page from disk
+// Report whether a page has been written since its contents were
+// last saved. Writes to a W mapping don't trap, so fold in the
+// hardware PTE_D bit of resident pages.
 int
-swapin_page(struct proc *p, uint64 va)
+page_is_dirty(struct proc *p, struct page_info *pi)
+{
+  int mega;
+
+  if(!pi->dirty && pi->resident) {
+    pte_t *pte = walkleaf(p->pagetable, pi->va, &mega);
+    if(pte && (*pte & PTE_V) && (*pte & PTE_D))
+      pi->dirty = 1;
+  }
+  return pi->dirty;
+}
+
+// Mark page as dirty
+void
+mark_page_dirty(struct proc *p, uint64 va)
 {
-  va = PGROUNDDOWN(va);
-  
   struct page_info *pi = find_page_info(p, va);
-  if(pi == 0 || !pi->swapped)
-    return -1;
-  
-  // Allocate physical page
-  uint64 mem = (uint64)kalloc();
-  if(mem == 0) {
-    // Out of memory during swap-in
-    printf("[pid %d] MEMFULL\n", p->pid);
-    
-    // Try to evict a page
-    if(evict_page(p) == 0)
-      return -1;
-    
-    mem = (uint64)kalloc();
-    if(mem == 0)
-      return -1;
+  if(pi)
+    pi->dirty = 1;
+}
+
+static uint64 vmfault_locked(pagetable_t, uint64, uint64);
+
+// Write fault on a copy-on-write page. Copy it unless this is the
+// last mapping, then make it writable. The page stays resident
+// with the same seq; only its frame may change. A megapage is split
+// first; if there is no memory for that, the fault fails as out of
+// memory. The caller holds p->vmlock.
+static uint64
+cow_fault(struct proc *p, uint64 va)
+{
+  struct page_info *pi;
+  pte_t *pte;
+  uint64 pa, mem = 0;
+
+  if((pte = walk(p->pagetable, va, 0)) == 0) {
+    trace(TR_MEMFULL, p->pid, 0, 0, 0);
+    return 0;
   }
-  
-  // Read from swap file
-  if(p->swapfile == 0) {
-    kfree((void*)mem);
-    return -1;
+  pa = PTE2PA(*pte);
+  if(krefcount((void*)pa) > 1) {
+    if((mem = alloc_user_page(p)) == 0)
+      return 0;
+    // Eviction may have taken this very page; fault it back in.
+    pte = walk(p->pagetable, va, 0);
+    if(pte == 0 || (*pte & PTE_V) == 0) {
+      kfree((void*)mem);
+      return vmfault_locked(p->pagetable, va, 15);
+    }
+    pa = PTE2PA(*pte);
   }
+
+  if(mem && krefcount((void*)pa) > 1) {
+    memmove((void*)mem, (void*)pa, PGSIZE);
+    *pte = PA2PTE(mem) | ((PTE_FLAGS(*pte) | PTE_W) & ~PTE_COW);
+    kfree((void*)pa);
+    pa = mem;
+  } else {
+    if(mem)
+      kfree((void*)mem);
+    *pte = (*pte | PTE_W) & ~PTE_COW;
+  }
+  sfence_vma();
+
+  // A page that read the zero page now has a frame of its own.
+  pi = find_page_info(p, va);
+  if(pi && pi->zero) {
+    pi->zero = 0;
+    resident_add(p, pi);
+    trace(TR_ALLOC, p->pid, va, 0, 0);
+  } else {
+    trace(TR_COW, p->pid, va, 0, 0);
+  }
+  mark_page_dirty(p, va);
+  return pa;
+}
+
+// Fill frame mem with the page of segment seg at va: file
+// contents up to filesz, zeros after. The file blocks behind the
+// page are read together. The caller holds p->exec_inode locked.
+static int
+load_exec_page(struct proc *p, struct prog_segment *seg, uint64 va, uint64 mem)
+{
+  uint64 offset_in_seg = va - seg->vaddr;
+  uint64 file_offset = seg->off + offset_in_seg;
   
-  int slot = pi->swap_offset;
-  
-  begin_op();
-  ilock(p->swapfile->ip);
-  
-  // Read page from swap file at offset (slot * PGSIZE)
-  int n = readi(p->swapfile->ip, 0, mem, slot * PGSIZE, PGSIZE);
-  
-  iunlock(p->swapfile->ip);
-  end_op();
+  memset((void*)mem, 0, PGSIZE);
   
-  if(n != PGSIZE) {
+  // Load from file if within filesz
+  if(offset_in_seg < seg->filesz) {
+    uint64 to_read = PGSIZE;
+    if(offset_in_seg + PGSIZE > seg->filesz)
+      to_read = seg->filesz - offset_in_seg;
+    
+    iprefetch(p->exec_inode, file_offset, to_read);
+    if(readi(p->exec_inode, 0, mem, file_offset, to_read) != to_read)
+      return -1;
+  }
+  return 0;
+}
+
+// Get a frame holding the page of seg at va, with a reference for
+// mapping it at va. Pages of read-only segments come from, and go
+// into, the shared page cache. A missing page is read into a frame
+// from alloc_user_page() if evict is set; otherwise only a frame
+// that is free above the page-out low watermark will do.
+// The caller holds p->exec_inode locked. Returns 0 on failure.
+static uint64
+exec_page(struct proc *p, struct prog_segment *seg, uint64 va, int evict)
+{
+  struct inode *ip = p->exec_inode;
+  uint64 off = va - seg->vaddr;
+  uint len = 0;
+  uint64 mem;
+
+  if(off < seg->filesz)
+    len = seg->filesz - off < PGSIZE ? seg->filesz - off : PGSIZE;
+  int shared = (seg->perm & PTE_W) == 0 && len > 0;
+
+  if(evict)
+    rss_enforce(p, 1);
+  if(shared && (mem = pcache_get(ip->dev, ip->inum, seg->off + off, len)) != 0)
+    return mem;
+
+  if(evict)
+    mem = alloc_user_page(p);
+  else
+    mem = kfreecount() > pageout.st.low ? (uint64)kalloc() : 0;
+  if(mem == 0)
+    return 0;
+  if(load_exec_page(p, seg, va, mem) < 0) {
     kfree((void*)mem);
-    return -1;
+    return 0;
   }
-  
-  printf("[pid %d] SWAPIN va=0x%lx slot=%d\n", p->pid, va, slot);
-  
-  // Get permissions from segment info or default to RW
-  int perm = PTE_U | PTE_R | PTE_W;
-  for(int i = 0; i < p->nsegments; i++) {
-    if(va >= p->segments[i].vaddr && va < p->segments[i].vaddr + p->segments[i].memsz) {
-      perm = p->segments[i].perm | PTE_U | PTE_R;
+  if(shared)
+    mem = pcache_add(ip->dev, ip->inum, seg->off + off, len, mem);
+  return mem;
+}
+
+// Fault-around: after loading the page of seg at va, also load the
+// other pages of the same aligned window of faultaround pages that
+// the file backs and that were never loaded (or were discarded), so
+// that starting a program takes a fault per window, not per page.
+// Cached pages are mapped as they are; others are read only into
+// frames that are free without evicting. The caller holds
+// p->exec_inode locked.
+static void
+fault_around(struct proc *p, struct prog_segment *seg, uint64 va)
+{
+  uint64 win = faultaround * PGSIZE;
+  uint64 start = va - va % win;
+  uint64 end = start + win;
+  uint64 a, mem;
+  int n = 0;
+
+  if(madv_at(p, va) == MADV_RANDOM)
+    return;
+  if(start < seg->vaddr)
+    start = seg->vaddr;
+  if(end > PGROUNDUP(seg->vaddr + seg->filesz))
+    end = PGROUNDUP(seg->vaddr + seg->filesz);
+
+  for(a = start; a < end; a += PGSIZE) {
+    if(a == va || ismapped(p->pagetable, a) || find_page_info(p, a))
+      continue;
+    if(p->rsslimit && p->nresident >= p->rsslimit)
+      break;
+    if((mem = exec_page(p, seg, a, 0)) == 0)
+      break;
+    if(mappages(p->pagetable, a, PGSIZE, mem, seg->perm | PTE_U | PTE_R) != 0) {
+      kfree((void*)mem);
+      break;
+    }
+    if(add_page_info(p, a) == 0) {
+      uvmunmap(p->pagetable, a, 1, 1);
       break;
     }
+    trace(TR_FAULTAROUND, p->pid, a, 0, 0);
+    n++;
   }
-  
-  // Map the page
-  if(mappages(p->pagetable, va, PGSIZE, mem, perm) != 0) {
-    kfree((void*)mem);
-    return -1;
+
+  if(n) {
+    acquire(&rastat.lock);
+    rastat.st.faultaround += n;
+    release(&rastat.lock);
   }
-  
-  // Free the swap slot since page is now in memory
-  free_swap_slot(p, slot);
-  
-  pi->resident = 1;
-  pi->seq = p->next_seq++;
-  pi->dirty = 0;
-  pi->swapped = 0;  // No longer swapped
-  
-  printf("[pid %d] RESIDENT va=0x%lx seq=%d\n", p->pid, va, (int)pi->seq);
-  
-  return 0;
 }
 
-// Mark page as dirty
-void
-mark_page_dirty(struct proc *p, uint64 va)
+// Fault in the page at va of mapped file r from the file.
+// The caller holds p->vmlock.
+static uint64
+mmap_fault(struct proc *p, struct mmap_region *r, uint64 va, int access)
 {
-  struct page_info *pi = find_page_info(p, va);
-  if(pi)
+  struct page_info *pi;
+  uint64 mem;
+
+  if((access == TRA_WRITE && (r->perm & PTE_W) == 0) ||
+     (access == TRA_EXEC && (r->perm & PTE_X) == 0)) {
+    printf("[pid %d] KILL invalid-access va=0x%lx access=%s\n", p->pid, va,
+           access == TRA_WRITE ? "write" : "exec");
+    p->killed = 1;
+    return 0;
+  }
+  trace(TR_PAGEFAULT, p->pid, va, access | TRC_MMAP << 4, 0);
+  pstat_fault(p, PF_MMAP);
+
+  if((mem = alloc_user_page(p)) == 0)
+    return 0;
+  if(mmap_readpage(r, va, mem) < 0 ||
+     mappages(p->pagetable, va, PGSIZE, mem, r->perm | PTE_U) != 0) {
+    kfree((void*)mem);
+    return 0;
+  }
+  if((pi = add_page_info(p, va)) == 0) {
+    uvmunmap(p->pagetable, va, 1, 1);
+    return 0;
+  }
+  if(access == TRA_WRITE)
     pi->dirty = 1;
+  trace(TR_RESIDENT, p->pid, va, 0, (int)pi->seq);
+  return mem;
+}
+
+// Map the whole MEGASIZE block around a heap write fault at va
+// with one megapage: the block must lie in the lazily grown heap,
+// have nothing mapped or swapped out in it yet, and leave the
+// daemon's high watermark free. Its pages are tracked, and evicted, one by one
+// like any other; evicting one splits the megapage (see walk).
+// Returns the frame for va, or 0 to fall back to a single page.
+static uint64
+mega_fault(struct proc *p, uint64 va)
+{
+  uint64 base = MEGAROUNDDOWN(va), pa;
+  struct page_info *pi;
+  struct page_chunk *c;
+  int i, mega, n = MEGASIZE / PGSIZE;
+
+  if(!megapages || p->stack_top == 0 || base < p->stack_top ||
+     base + MEGASIZE > PGROUNDUP(p->sz))
+    return 0;
+  if(walkleaf(p->pagetable, base, &mega) != 0)
+    return 0;
+  // A block with no page table may still have pages in swap, e.g.
+  // in a forked child or after unmap_level() freed the table.
+  for(i = 0; i < n; i++)
+    if(find_page_info(p, base + i*PGSIZE) != 0)
+      return 0;
+  if(kfreecount() < n + pageout.st.high)
+    return 0;
+  if(p->rsslimit && p->nresident + n > p->rsslimit)
+    return 0;
+
+  // Grow the metadata first, so tracking the pages can't evict.
+  for(i = 0, pi = p->page_free; pi && i < n; pi = pi->next)
+    i++;
+  for(; i < n; i += PAGE_CHUNK_N) {
+    if((c = (struct page_chunk*)alloc_user_page(p)) == 0)
+      return 0;
+    page_chunk_add(p, c);
+  }
+
+  if((pa = (uint64)kalloc_mega()) == 0)
+    return 0;
+  memset((void*)pa, 0, MEGASIZE);
+  if(megamap(p->pagetable, base, PA2PTE(pa) | PTE_R | PTE_W | PTE_U | PTE_V) != 0) {
+    for(i = 0; i < n; i++)
+      kfree((void*)(pa + i*PGSIZE));
+    return 0;
+  }
+  for(i = 0; i < n; i++)
+    add_page_info(p, base + i*PGSIZE);
+  mark_page_dirty(p, va);
+
+  __sync_fetch_and_add(&megastat.mapped, 1);
+  return pa + (va - base);
+}
+
+// After a fault in a MADV_SEQUENTIAL range, the page MADV_BEHIND
+// pages back is unlikely to be used again soon: make it the next
+// victim, so that a sequential scan doesn't push out other pages.
+// The caller holds p->vmlock.
+static void
+drop_behind(struct proc *p, uint64 va)
+{
+  struct page_info *pi;
+
+  va = PGROUNDDOWN(va);
+  if(va < MADV_BEHIND * PGSIZE || madv_at(p, va) != MADV_SEQUENTIAL)
+    return;
+  va -= MADV_BEHIND * PGSIZE;
+  if(madv_at(p, va) != MADV_SEQUENTIAL)
+    return;
+  if((pi = find_page_info(p, va)) != 0 && pi->resident)
+    resident_demote(p, pi);
 }
 
-// Enhanced page fault handler for demand paging
+// Page fault handler for demand paging.
 // scause: 12=exec, 13=read, 15=write
+// Returns the physical address now mapped at va, or 0.
 uint64
 vmfault(pagetable_t pagetable, uint64 va, uint64 scause)
 {
   struct proc *p = myproc();
-  uint64 mem;
+  uint64 pa, t0 = r_time();
+
+  acquiresleep(&p->vmlock);
+  pa = vmfault_locked(pagetable, va, scause);
+  if(pa)
+    drop_behind(p, va);
+  pstat_time(p, LAT_FAULT, t0);
+  releasesleep(&p->vmlock);
+  pageout_kick();
+  return pa;
+}
+
+// Fault in a page on behalf of copyin()/copyout(), but only if the
+// VA looks valid for this process.
+static uint64
+uvmfault(pagetable_t pagetable, uint64 va, uint64 scause)
+{
+  struct proc *p = myproc();
+  uint64 pa = 0, t0 = r_time();
+
+  acquiresleep(&p->vmlock);
+  p->fsfault = 1;
+  if(is_valid_user_va(p, va) && (pa = vmfault_locked(pagetable, va, scause)) != 0)
+    drop_behind(p, va);
+  p->fsfault = 0;
+  pstat_time(p, LAT_FAULT, t0);
+  releasesleep(&p->vmlock);
+  pageout_kick();
+  return pa;
+}
+
+// Enhanced page fault handler for demand paging.
+// The caller holds p->vmlock.
+static uint64
+vmfault_locked(pagetable_t pagetable, uint64 va, uint64 scause)
+{
+  struct proc *p = myproc();
+  uint64 mem = 0;
   
   va = PGROUNDDOWN(va);
   
   // Determine access type from scause
   const char *access_type;
-  int is_write = 0;
+  int access, is_write = 0;
   if(scause == 12) {
     access_type = "exec";
+    access = TRA_EXEC;
   } else if(scause == 13) {
     access_type = "read";
+    access = TRA_READ;
   } else { // scause == 15
     access_type = "write";
+    access = TRA_WRITE;
     is_write = 1;
   }
   
@@ -909,8 +2603,10 @@ vmfault(pagetable_t pagetable, uint64 va, uint64 scause)
 
   // Check if already mapped
   if(ismapped(pagetable, va)) {
-    // Validate permissions for the faulting access type.
-    pte_t *pte = walk(pagetable, va, 0);
+    // Validate permissions for the faulting access type. A megapage
+    // is looked at whole; only a copy-on-write fault splits it.
+    int mega;
+    pte_t *pte = walkleaf(pagetable, va, &mega);
     if(pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_U) == 0) {
       // Treat as invalid mapping
       printf("[pid %d] KILL invalid-access va=0x%lx access=%s\n", p->pid, va, access_type);
@@ -918,6 +2614,12 @@ vmfault(pagetable_t pagetable, uint64 va, uint64 scause)
       return 0;
     }
 
+    pstat_fault(p, PF_MINOR);
+
+    // A write to a page shared by fork() gets a private copy.
+    if(is_write && (*pte & PTE_COW))
+      return cow_fault(p, va);
+
     // scause 12: exec, require X; 13: read, require R; 15: write, require W
     int ok = 1;
     if(scause == 12) {
@@ -945,8 +2647,8 @@ vmfault(pagetable_t pagetable, uint64 va, uint64 scause)
   // Check if page was swapped out
   struct page_info *pi = find_page_info(p, va);
   if(pi && pi->swapped) {
-    printf("[pid %d] PAGEFAULT va=0x%lx access=%s cause=swap\n", 
-           p->pid, va, access_type);
+    trace(TR_PAGEFAULT, p->pid, va, access | TRC_SWAP << 4, 0);
+    pstat_fault(p, PF_SWAP);
     if(swapin_page(p, va) < 0) {
       return 0;
     }
@@ -991,69 +2693,84 @@ vmfault(pagetable_t pagetable, uint64 va, uint64 scause)
                 (va >= PGROUNDDOWN(sp) - PGSIZE || sp >= p->sz));
   }
   
+  // 4. Check if in a mapped file
+  struct mmap_region *r = mmap_find(p, va);
+  if(r)
+    return mmap_fault(p, r, va, access);
+
   if(!in_segment && !in_heap && !in_stack) {
     printf("[pid %d] KILL invalid-access va=0x%lx access=%s\n", p->pid, va, access_type);
     p->killed = 1;
     return 0;
   }
   
-  // Allocate physical memory
-  mem = (uint64)kalloc();
-  if(mem == 0) {
-    // Out of memory - trigger page replacement
-    printf("[pid %d] MEMFULL\n", p->pid);
-    
-    // Try to evict a page from this process's resident set
-    if(evict_page(p) == 0) {
+  // A read of an untouched heap or stack page maps the shared zero
+  // page; the first write gives it a frame of its own (cow_fault).
+  // It isn't resident, so eviction never considers it.
+  if(!in_segment && !is_write) {
+    trace(TR_PAGEFAULT, p->pid, va, access | (in_heap ? TRC_HEAP : TRC_STACK) << 4, 0);
+    pstat_fault(p, in_heap ? PF_HEAP : PF_STACK);
+    if(mappages(pagetable, va, PGSIZE, (uint64)zeropage, PTE_R | PTE_U | PTE_COW) != 0)
       return 0;
-    }
-    
-    mem = (uint64)kalloc();
-    if(mem == 0) {
+    kref(zeropage);
+    if((pi = track_page(p, va)) == 0) {
+      uvmunmap(pagetable, va, 1, 1);
       return 0;
     }
+    pi->zero = 1;
+    trace(TR_ZEROPAGE, p->pid, va, 0, 0);
+    return (uint64)zeropage;
   }
+
+  // A write into a large lazily grown heap may get a megapage.
+  if(!in_segment && in_heap && (mem = mega_fault(p, va)) != 0) {
+    trace(TR_PAGEFAULT, p->pid, va, access | TRC_HEAP << 4, 0);
+    pstat_fault(p, PF_HEAP);
+    trace(TR_MEGAPAGE, p->pid, MEGAROUNDDOWN(va), 0, 0);
+    return mem;
+  }
+
+  // Allocate physical memory; exec_page() finds executable pages
+  if(!in_segment && (mem = alloc_user_page(p)) == 0)
+    return 0;
   
   // Handle different page types
   if(in_segment) {
     // Load from executable
-    printf("[pid %d] PAGEFAULT va=0x%lx access=%s cause=exec\n", 
-           p->pid, va, access_type);
+    trace(TR_PAGEFAULT, p->pid, va, access | TRC_EXEC << 4, 0);
+    pstat_fault(p, PF_EXEC);
     
     struct prog_segment *seg = &p->segments[seg_index];
-    uint64 offset_in_seg = va - seg->vaddr;
-    uint64 file_offset = seg->off + offset_in_seg;
+    int fsfault = p->fsfault;
     
-    memset((void*)mem, 0, PGSIZE);
-    
-    // Load from file if within filesz
-    if(offset_in_seg < seg->filesz) {
-      uint64 to_read = PGSIZE;
-      if(offset_in_seg + PGSIZE > seg->filesz)
-        to_read = seg->filesz - offset_in_seg;
-      
-      ilock(p->exec_inode);
-      if(readi(p->exec_inode, 0, mem, file_offset, to_read) != to_read) {
-        iunlock(p->exec_inode);
-        kfree((void*)mem);
-        return 0;
-      }
+    // Evicting a dirty shared page now would begin_op() with the
+    // inode locked, or lock it again if it is what's mapped.
+    ilock(p->exec_inode);
+    p->fsfault = 1;
+    if((mem = exec_page(p, seg, va, 1)) == 0) {
+      p->fsfault = fsfault;
       iunlock(p->exec_inode);
+      return 0;
     }
     
     // Map with appropriate permissions
     int perm = seg->perm | PTE_U | PTE_R;
     if(mappages(pagetable, va, PGSIZE, mem, perm) != 0) {
+      p->fsfault = fsfault;
+      iunlock(p->exec_inode);
       kfree((void*)mem);
       return 0;
     }
     
-    printf("[pid %d] LOADEXEC va=0x%lx\n", p->pid, va);
+    trace(TR_LOADEXEC, p->pid, va, 0, 0);
+    fault_around(p, seg, va);
+    p->fsfault = fsfault;
+    iunlock(p->exec_inode);
     
   } else if(in_heap) {
     // Zero-filled heap page
-    printf("[pid %d] PAGEFAULT va=0x%lx access=%s cause=heap\n", 
-           p->pid, va, access_type);
+    trace(TR_PAGEFAULT, p->pid, va, access | TRC_HEAP << 4, 0);
+    pstat_fault(p, PF_HEAP);
     
     memset((void*)mem, 0, PGSIZE);
     
@@ -1062,12 +2779,12 @@ vmfault(pagetable_t pagetable, uint64 va, uint64 scause)
       return 0;
     }
     
-    printf("[pid %d] ALLOC va=0x%lx\n", p->pid, va);
+    trace(TR_ALLOC, p->pid, va, 0, 0);
     
   } else if(in_stack) {
     // Zero-filled stack page
-    printf("[pid %d] PAGEFAULT va=0x%lx access=%s cause=stack\n", 
-           p->pid, va, access_type);
+    trace(TR_PAGEFAULT, p->pid, va, access | TRC_STACK << 4, 0);
+    pstat_fault(p, PF_STACK);
     
     memset((void*)mem, 0, PGSIZE);
     
@@ -1076,7 +2793,7 @@ vmfault(pagetable_t pagetable, uint64 va, uint64 scause)
       return 0;
     }
     
-    printf("[pid %d] ALLOC va=0x%lx\n", p->pid, va);
+    trace(TR_ALLOC, p->pid, va, 0, 0);
   }
   
   // Add to page tracking
@@ -1090,7 +2807,7 @@ vmfault(pagetable_t pagetable, uint64 va, uint64 scause)
   if(is_write)
     pi->dirty = 1;
   
-  printf("[pid %d] RESIDENT va=0x%lx seq=%d\n", p->pid, va, (int)pi->seq);
+  trace(TR_RESIDENT, p->pid, va, 0, (int)pi->seq);
   
   return mem;
 }
@@ -1098,7 +2815,8 @@ vmfault(pagetable_t pagetable, uint64 va, uint64 scause)
 int
 ismapped(pagetable_t pagetable, uint64 va)
 {
-  pte_t *pte = walk(pagetable, va, 0);
+  int mega;
+  pte_t *pte = walkleaf(pagetable, va, &mega);
   if (pte == 0) {
     return 0;
   }
@@ -1107,3 +2825,125 @@ ismapped(pagetable_t pagetable, uint64 va)
   }
   return 0;
 }
+
+// Is va in one of p's program segments?
+static int
+in_segment(struct proc *p, uint64 va)
+{
+  for(int i = 0; i < p->nsegments; i++) {
+    if(va >= p->segments[i].vaddr && va < p->segments[i].vaddr + p->segments[i].memsz)
+      return 1;
+  }
+  return 0;
+}
+
+// Apply an access hint (MADV_*) to the pages of [va, va+len) of
+// the current process. RANDOM and SEQUENTIAL steer readahead,
+// fault-around and eviction for the range; one such range is kept
+// per process, and NORMAL clears it. WILLNEED faults in swapped,
+// executable and lazy heap pages while memory is free above the
+// low watermark, without evicting. DONTNEED unmaps the pages and
+// forgets them, freeing their frames and swap slots; they read back
+// as zeros, or from the executable. Returns -1 on a bad range.
+int
+madvise(uint64 va, uint64 len, int advice)
+{
+  struct proc *p = myproc();
+  struct page_info *pi;
+  uint64 a, end;
+
+  if(va % PGSIZE || va + len < va || va + len > p->sz)
+    return -1;
+  end = PGROUNDUP(va + len);
+
+  acquiresleep(&p->vmlock);
+  switch(advice){
+  case MADV_NORMAL:
+  case MADV_RANDOM:
+  case MADV_SEQUENTIAL:
+    p->madv = advice;
+    p->madv_lo = va;
+    p->madv_hi = end;
+    break;
+  case MADV_WILLNEED:
+    for(a = va; a < end && kfreecount() > pageout.st.low && !p->killed; a += PGSIZE) {
+      if(p->rsslimit && p->nresident >= p->rsslimit)
+        break;
+      if(ismapped(p->pagetable, a))
+        continue;
+      pi = find_page_info(p, a);
+      if((pi && pi->swapped) || in_segment(p, a))
+        vmfault_locked(p->pagetable, a, 13);
+      else if(p->stack_top > 0 && a >= p->stack_top)
+        vmfault_locked(p->pagetable, a, 15);
+    }
+    break;
+  case MADV_DONTNEED:
+    if(unmap_range(p, va, end) < 0) {
+      releasesleep(&p->vmlock);
+      return -1;
+    }
+    break;
+  default:
+    releasesleep(&p->vmlock);
+    return -1;
+  }
+  releasesleep(&p->vmlock);
+  pageout_kick();
+  return 0;
+}
+
+// Limit the current process's resident set to pages pages, or
+// lift the limit if pages is 0; a negative argument only queries
+// it. A lower limit takes effect at once. Returns the previous
+// limit, or -1 if pages is below RSS_MIN.
+int
+rsslimit(int pages)
+{
+  struct proc *p = myproc();
+  int old = p->rsslimit;
+
+  if(pages < 0)
+    return old;
+  if(pages > 0 && pages < RSS_MIN)
+    return -1;
+  acquiresleep(&p->vmlock);
+  p->rsslimit = pages;
+  rss_enforce(p, 0);
+  releasesleep(&p->vmlock);
+  return old;
+}
+
+// Working-set estimation: every WSSTICKS ticks that p runs, count
+// its resident pages used since the last sample (PTE_A set), then
+// clear their PTE_A bits. p->wss is a running average in which each
+// sample weighs half, rounded towards the newest count so that it
+// settles on a steady one, and decays to 0 when p goes idle.
+// CLOCK and readahead still see the bits in pi->accessed. Called at timer
+// interrupts from user space; skipped if p's memory is busy.
+void
+wss_sample(struct proc *p)
+{
+  struct page_info *pi;
+  pte_t *pte;
+  int mega, n = 0;
+
+  if(ticks - p->wss_tick < WSSTICKS || !tryacquiresleep(&p->vmlock))
+    return;
+  p->wss_tick = ticks;
+  for(pi = p->fifo_head; pi; pi = pi->next) {
+    pte = walkleaf(p->pagetable, pi->va, &mega);
+    if(pte && (*pte & PTE_V) && (*pte & PTE_A)) {
+      pi->accessed = 1;
+      n++;
+    }
+  }
+  // A megapage's pages share one PTE_A: clear it after counting them.
+  for(pi = p->fifo_head; pi; pi = pi->next) {
+    if(pi->accessed && (pte = walkleaf(p->pagetable, pi->va, &mega)) != 0)
+      *pte &= ~PTE_A;
+  }
+  sfence_vma();
+  p->wss = (p->wss + n + (n > p->wss)) / 2;
+  releasesleep(&p->vmlock);
+}
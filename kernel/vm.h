@@ -1,2 +1,27 @@
 #define SBRK_EAGER 1
 #define SBRK_LAZY  2
+
+// Page replacement algorithms, see pagealgo()
+#define PAGEALGO_FIFO  0
+#define PAGEALGO_CLOCK 1
+
+// Replacement scope, see pagescope()
+#define PAGESCOPE_LOCAL  0   // evict from the faulting process only
+#define PAGESCOPE_GLOBAL 1   // evict from any process
+
+// Access hints, see madvise()
+#define MADV_NORMAL     0
+#define MADV_RANDOM     1   // no readahead or fault-around
+#define MADV_SEQUENTIAL 2   // full readahead; pages behind go first
+#define MADV_WILLNEED   3   // fault the range in now
+#define MADV_DONTNEED   4   // drop the range's pages and swap slots
+
+// Smallest resident-set limit but 0 (none), see rsslimit()
+#define RSS_MIN      16
+
+// mmap() protection and flags
+#define PROT_READ    1
+#define PROT_WRITE   2
+#define PROT_EXEC    4
+#define MAP_SHARED   1      // writes go back to the file
+#define MAP_PRIVATE  2      // writes stay in this process
@@ -0,0 +1,381 @@
+// Compressed swap cache.
+//
+// A page written to a swap slot is first compressed, with a small
+// LZ77 coder, into a pool of kalloc()ed pages; if it shrinks to at
+// most half a page and the pool has room, the disk write is skipped.
+// Pages that don't compress, or that don't fit, go to disk as
+// before. Reading a slot decompresses the page if the pool holds it.
+//
+// The pool is keyed by swap slot, so forked processes sharing a slot
+// share its compressed copy, and a page swapped in and not written
+// since can be evicted again without a write (SWAPKEEP): an entry
+// stays until its slot is freed (zswap_drop), or until memory runs
+// short and zswap_shrink() writes it to its slot on disk. The pool
+// doesn't grow while free memory is below the page-out daemon's
+// low watermark.
+//
+// Pool pages are split into ZCHUNK-byte chunks; a compressed page
+// takes a run of chunks in one pool page. zpool.lock covers only
+// the pool; compressing and writing back use per-CPU scratch space.
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "memstat.h"
+
+#define ZCHUNK    64                  // pool allocation unit, bytes
+#define ZNCHUNK   (PGSIZE / ZCHUNK)   // chunks per pool page: one bitmap word
+#define ZMAXLEN   (PGSIZE / 2)        // largest compressed page kept
+#define ZHASH     4096                // compressor hash table entries
+#define ZMINMATCH 3
+#define ZMAXMATCH (127 + ZMINMATCH)
+
+struct zpage {
+  char *mem;       // pool page, 0 if not allocated
+  uint64 used;     // bitmap of chunks in use
+  int nfree;       // chunks not in use
+};
+
+struct zentry {
+  short page;      // index in zpool.pages, -1 if the slot isn't held
+  uchar chunk;     // first chunk
+  ushort len;      // compressed length, bytes
+};
+
+struct {
+  struct spinlock lock;
+  struct zpage pages[ZSWAPPAGES];
+  struct zentry e[SWAPPAGES];
+  int npages;
+  int nstored;
+  int nbytes;
+  int hits;
+  int misses;
+  int rejects;
+  int writebacks;
+  uint64 ctime, dtime;        // time CSR ticks spent (de)compressing
+} zpool;
+
+// Scratch space for compressing a page or writing one back, one per
+// CPU so that harts don't wait for each other. The sleeplock covers
+// a process that is preempted or sleeps while using it.
+struct zscratch {
+  char page[PGSIZE];          // write-back: decompressed page
+  uchar buf[ZMAXLEN];         // compressor output
+  ushort hash[ZHASH];         // compressor: last position + 1 of a 3-byte prefix
+  struct sleeplock lock;
+} __attribute__((aligned(PGSIZE))) zscratch[NCPU];
+
+int zswap = ZSWAP;
+
+void
+zswapinit(void)
+{
+  initlock(&zpool.lock, "zswap");
+  for(int i = 0; i < SWAPPAGES; i++)
+    zpool.e[i].page = -1;
+  for(int i = 0; i < NCPU; i++)
+    initsleeplock(&zscratch[i].lock, "zscratch");
+}
+
+// Lock and return this CPU's scratch space. The process may move to
+// another CPU meanwhile; it then just shares the old one's.
+static struct zscratch*
+zscratch_get(void)
+{
+  struct zscratch *z;
+
+  push_off();
+  z = &zscratch[cpuid()];
+  pop_off();
+  acquiresleep(&z->lock);
+  return z;
+}
+
+// Compressed format: a control byte c < 128 is followed by c+1
+// literal bytes; c >= 128 copies (c & 127) + ZMINMATCH bytes from a
+// 16-bit little-endian distance back in the output, which may
+// overlap what is being copied (runs).
+
+// Emit literals src[0..n) to dst at *o. Returns -1 if past max.
+static int
+zliterals(uchar *dst, int *o, int max, uchar *src, int n)
+{
+  while(n > 0) {
+    int k = n < 128 ? n : 128;
+    if(*o + 1 + k > max)
+      return -1;
+    dst[(*o)++] = k - 1;
+    memmove(dst + *o, src, k);
+    *o += k;
+    src += k;
+    n -= k;
+  }
+  return 0;
+}
+
+// Compress the page at src into dst, using the ZHASH entries at
+// hash. Returns the compressed length, or -1 if it would exceed max.
+static int
+zcompress(uchar *src, uchar *dst, int max, ushort *hash)
+{
+  int i = 0, lit = 0, o = 0;
+
+  memset(hash, 0, ZHASH * sizeof(hash[0]));
+  while(i + ZMINMATCH <= PGSIZE) {
+    uint h = ((src[i] << 16 | src[i+1] << 8 | src[i+2]) * 2654435761U) >> 20;
+    int cand = hash[h] - 1;
+    hash[h] = i + 1;
+    if(cand < 0 || src[cand] != src[i] || src[cand+1] != src[i+1] || src[cand+2] != src[i+2]) {
+      i++;
+      continue;
+    }
+    int len = ZMINMATCH;
+    while(len < ZMAXMATCH && i + len < PGSIZE && src[cand+len] == src[i+len])
+      len++;
+    if(zliterals(dst, &o, max, src + lit, i - lit) < 0 || o + 3 > max)
+      return -1;
+    dst[o++] = 0x80 | (len - ZMINMATCH);
+    dst[o++] = (i - cand) & 0xff;
+    dst[o++] = (i - cand) >> 8;
+    i += len;
+    lit = i;
+  }
+  if(zliterals(dst, &o, max, src + lit, PGSIZE - lit) < 0)
+    return -1;
+  return o;
+}
+
+// Decompress n bytes at src into the page at dst.
+// Returns -1 if the data is corrupt.
+static int
+zdecompress(uchar *src, int n, uchar *dst)
+{
+  int i = 0, o = 0, len, dist;
+
+  while(i < n) {
+    int c = src[i++];
+    if(c < 128) {
+      len = c + 1;
+      if(i + len > n || o + len > PGSIZE)
+        return -1;
+      memmove(dst + o, src + i, len);
+      i += len;
+    } else {
+      len = (c & 127) + ZMINMATCH;
+      if(i + 2 > n)
+        return -1;
+      dist = src[i] | src[i+1] << 8;
+      i += 2;
+      if(dist == 0 || dist > o || o + len > PGSIZE)
+        return -1;
+      for(int k = 0; k < len; k++)
+        dst[o + k] = dst[o - dist + k];
+    }
+    o += len;
+  }
+  return o == PGSIZE ? 0 : -1;
+}
+
+// Find a run of n free chunks, growing the pool if need be and
+// memory isn't short. Returns the pool page index, with the first
+// chunk in *chunk, or -1 if the pool is full.
+static int
+zalloc(int n, int *chunk)
+{
+  uint64 mask = (n == ZNCHUNK ? ~0UL : (1UL << n) - 1);
+  struct zpage *z, *empty = 0;
+
+  for(z = zpool.pages; z < &zpool.pages[ZSWAPPAGES]; z++) {
+    if(z->mem == 0) {
+      if(empty == 0)
+        empty = z;
+      continue;
+    }
+    if(z->nfree < n)
+      continue;
+    for(int c = 0; c + n <= ZNCHUNK; c++) {
+      if((z->used & (mask << c)) == 0) {
+        z->used |= mask << c;
+        z->nfree -= n;
+        *chunk = c;
+        return z - zpool.pages;
+      }
+    }
+  }
+  if(empty == 0 || pageout_lowmem() || (empty->mem = kalloc()) == 0)
+    return -1;
+  zpool.npages++;
+  empty->used = mask;
+  empty->nfree = ZNCHUNK - n;
+  *chunk = 0;
+  return empty - zpool.pages;
+}
+
+// Forget the pool's copy of slot, if any. zpool.lock must be held.
+// Returns 1 if that emptied its pool page, which is then freed.
+static int
+zfree(int slot)
+{
+  struct zentry *e = &zpool.e[slot];
+  struct zpage *z;
+  int n;
+
+  if(e->page < 0)
+    return 0;
+  z = &zpool.pages[e->page];
+  n = (e->len + ZCHUNK - 1) / ZCHUNK;
+  z->used &= ~((n == ZNCHUNK ? ~0UL : (1UL << n) - 1) << e->chunk);
+  z->nfree += n;
+  zpool.nstored--;
+  zpool.nbytes -= e->len;
+  e->page = -1;
+  if(z->nfree == ZNCHUNK) {
+    kfree(z->mem);
+    z->mem = 0;
+    zpool.npages--;
+    return 1;
+  }
+  return 0;
+}
+
+// Keep the page at pa, being written to slot, in the pool.
+// Returns 0 if it is kept, -1 if it must go to disk.
+// The page is compressed without zpool.lock held.
+int
+zswap_store(int slot, uint64 pa)
+{
+  struct zentry *e = &zpool.e[slot];
+  struct zscratch *z;
+  int len, page, chunk;
+  uint64 t0, t;
+
+  if(!zswap) {
+    zswap_drop(slot);
+    return -1;
+  }
+  z = zscratch_get();
+  t0 = r_time();
+  len = zcompress((uchar*)pa, z->buf, ZMAXLEN, z->hash);
+  t = r_time() - t0;
+
+  acquire(&zpool.lock);
+  zfree(slot);
+  zpool.ctime += t;
+  if(len < 0 || (page = zalloc((len + ZCHUNK - 1) / ZCHUNK, &chunk)) < 0) {
+    zpool.rejects++;
+    release(&zpool.lock);
+    releasesleep(&z->lock);
+    return -1;
+  }
+  memmove(zpool.pages[page].mem + chunk * ZCHUNK, z->buf, len);
+  e->page = page;
+  e->chunk = chunk;
+  e->len = len;
+  zpool.nstored++;
+  zpool.nbytes += len;
+  release(&zpool.lock);
+  releasesleep(&z->lock);
+  return 0;
+}
+
+// Read slot into the page at pa from the pool.
+// Returns 0 if the pool holds it, -1 if it must come from disk.
+int
+zswap_load(int slot, uint64 pa)
+{
+  struct zentry *e = &zpool.e[slot];
+  uint64 t0;
+
+  acquire(&zpool.lock);
+  if(e->page < 0) {
+    zpool.misses++;
+    release(&zpool.lock);
+    return -1;
+  }
+  t0 = r_time();
+  if(zdecompress((uchar*)zpool.pages[e->page].mem + e->chunk * ZCHUNK, e->len, (uchar*)pa) < 0)
+    panic("zswap_load");
+  zpool.dtime += r_time() - t0;
+  zpool.hits++;
+  release(&zpool.lock);
+  return 0;
+}
+
+// Slot has been freed: drop its compressed copy.
+void
+zswap_drop(int slot)
+{
+  acquire(&zpool.lock);
+  zfree(slot);
+  release(&zpool.lock);
+}
+
+// Memory is short: write the entries of the emptiest pool page to
+// their slots on disk, so that the page can be freed. Each slot is
+// held meanwhile, so that it can't be freed and reused, and stays
+// in the pool until it is on disk, so that a concurrent swap-in
+// finds it in one place or the other. Returns 1 if a pool page
+// was freed.
+int
+zswap_shrink(void)
+{
+  struct zpage *zp, *best = 0;
+  struct zscratch *z;
+  int page, freed = 0;
+
+  acquire(&zpool.lock);
+  for(zp = zpool.pages; zp < &zpool.pages[ZSWAPPAGES]; zp++)
+    if(zp->mem && (best == 0 || zp->nfree > best->nfree))
+      best = zp;
+  release(&zpool.lock);
+  if(best == 0)
+    return 0;
+  page = best - zpool.pages;
+
+  z = zscratch_get();
+  for(int slot = 0; slot < SWAPPAGES && !freed; slot++) {
+    // Looked at without the lock; checked again below.
+    if(zpool.e[slot].page != page || swap_hold(slot) < 0)
+      continue;
+    acquire(&zpool.lock);
+    struct zentry *e = &zpool.e[slot];
+    if(e->page != page) {
+      release(&zpool.lock);
+      free_swap_slot(slot);
+      continue;
+    }
+    if(zdecompress((uchar*)zpool.pages[page].mem + e->chunk * ZCHUNK, e->len, (uchar*)z->page) < 0)
+      panic("zswap_shrink");
+    release(&zpool.lock);
+
+    swap_writeslot(slot, (uint64)z->page);
+
+    acquire(&zpool.lock);
+    freed = zfree(slot);
+    zpool.writebacks++;
+    release(&zpool.lock);
+    free_swap_slot(slot);
+  }
+  releasesleep(&z->lock);
+  return freed;
+}
+
+void
+zswap_getstat(struct zswap_stat *st)
+{
+  acquire(&zpool.lock);
+  st->pages = zpool.npages;
+  st->stored = zpool.nstored;
+  st->bytes = zpool.nbytes;
+  st->hits = zpool.hits;
+  st->misses = zpool.misses;
+  st->rejects = zpool.rejects;
+  st->writebacks = zpool.writebacks;
+  st->comp_us = zpool.ctime / (LATHZ / 1000000);
+  st->decomp_us = zpool.dtime / (LATHZ / 1000000);
+  release(&zpool.lock);
+}
@@ -0,0 +1,81 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memstat.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+// Exec-to-first-output latency. Each program is started REPS times
+// with its standard output on a pipe; the time from fork() to the
+// first byte on the pipe covers exec and the faults that load the
+// program until it prints. Runs once loading one page per fault and
+// once with fault-around.
+
+#define REPS 5
+
+static char *progs[][4] = {
+  { "echo", "hello", 0 },
+  { "ls", 0 },
+  { "wc", "README", 0 },
+  { "grep", "xv6", "README", 0 },
+  { "usertests", "-q", 0 },
+};
+#define NPROGS (sizeof(progs) / sizeof(progs[0]))
+
+// Ticks from fork to the first byte argv[0] writes.
+static int
+first_output(char **argv)
+{
+  int fds[2], pid, t0, ticks;
+  char c;
+
+  if(pipe(fds) < 0) {
+    printf("execbench: pipe failed\n");
+    exit(1);
+  }
+  t0 = uptime();
+  pid = fork();
+  if(pid < 0) {
+    printf("execbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0) {
+    close(1);
+    dup(fds[1]);
+    close(fds[0]);
+    close(fds[1]);
+    exec(argv[0], argv);
+    exit(1);
+  }
+  close(fds[1]);
+  read(fds[0], &c, 1);
+  ticks = uptime() - t0;
+  kill(pid);
+  close(fds[0]);
+  wait(0);
+  return ticks;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct vmstat st0, st1;
+  int sizes[] = { 1, FAULTAROUND };
+  int old = faultaround(0);
+
+  for(int s = 0; s < 2; s++) {
+    faultaround(sizes[s]);
+    for(int i = 0; i < NPROGS; i++) {
+      int ticks = 0;
+      vmstat(&st0);
+      for(int r = 0; r < REPS; r++)
+        ticks += first_output(progs[i]);
+      vmstat(&st1);
+      // One tick is about 100ms under qemu.
+      printf("execbench: faultaround=%d %s ms/exec=%d around=%d\n",
+             sizes[s], progs[i][0], ticks * 100 / REPS,
+             (st1.ra.faultaround - st0.ra.faultaround) / REPS);
+    }
+  }
+  faultaround(old);
+  exit(0);
+}
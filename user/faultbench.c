@@ -0,0 +1,66 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// Page fault latency microbenchmark.
+// For each size, a child fills its heap until about that many pages
+// are tracked by the kernel, then repeatedly frees and re-faults a
+// small window at the top of the heap. Every timed fault therefore
+// has to look up (and miss) a VA among npages tracked entries.
+
+#define WINDOW  16    // pages re-faulted per round
+#define ROUNDS  20
+#define SLACK   8     // text, data and stack pages already tracked
+
+static void
+bench(int npages)
+{
+  int fill = npages - SLACK - WINDOW;
+  char *base = sbrklazy(fill * 4096);
+  if(base == (char*)-1) {
+    printf("faultbench: sbrk failed\n");
+    exit(1);
+  }
+  for(int i = 0; i < fill; i++)
+    base[i * 4096] = 1;
+
+  int faults = 0;
+  int start = uptime();
+  for(int r = 0; r < ROUNDS; r++) {
+    char *w = sbrklazy(WINDOW * 4096);
+    if(w == (char*)-1) {
+      printf("faultbench: sbrk failed\n");
+      exit(1);
+    }
+    for(int i = 0; i < WINDOW; i++) {
+      w[i * 4096] = (char)r;
+      faults++;
+    }
+    sbrk(-WINDOW * 4096);
+  }
+  int ticks = uptime() - start;
+
+  // One tick is about 100ms under qemu.
+  printf("faultbench: tracked=%d faults=%d ticks=%d us/fault=%d\n",
+         npages, faults, ticks, ticks * 100000 / faults);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int sizes[] = { 64, 512, 1024 };
+
+  for(int i = 0; i < 3; i++) {
+    int pid = fork();
+    if(pid < 0) {
+      printf("faultbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0) {
+      bench(sizes[i]);
+      exit(0);
+    }
+    wait(0);
+  }
+  exit(0);
+}
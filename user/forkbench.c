@@ -0,0 +1,72 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// Fork latency microbenchmark.
+// For each size, a child grows to about that many resident pages,
+// then times FORKS fork()/exit()/wait() round trips. With
+// copy-on-write fork the cost should barely depend on the size.
+// Each forked child also writes one page, and the parent checks
+// that it still sees its own copy.
+
+#define FORKS   50
+
+static void
+bench(int npages)
+{
+  char *base = sbrk(npages * 4096);
+  if(base == (char*)-1) {
+    printf("forkbench: sbrk failed\n");
+    exit(1);
+  }
+  for(int i = 0; i < npages; i++)
+    base[i * 4096] = (char)i;
+
+  int start = uptime();
+  for(int f = 0; f < FORKS; f++) {
+    int pid = fork();
+    if(pid < 0) {
+      printf("forkbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0) {
+      base[(f % npages) * 4096] = -1;
+      exit(0);
+    }
+    wait(0);
+  }
+  int ticks = uptime() - start;
+
+  for(int i = 0; i < npages; i++) {
+    if(base[i * 4096] != (char)i) {
+      printf("forkbench: page %d changed by a child\n", i);
+      exit(1);
+    }
+  }
+
+  // One tick is about 100ms under qemu.
+  printf("forkbench: pages=%d forks=%d ticks=%d us/fork=%d\n",
+         npages, FORKS, ticks, ticks * 100000 / FORKS);
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int sizes[] = { 10, 100, 500 };
+  int status;
+
+  for(int i = 0; i < 3; i++) {
+    int pid = fork();
+    if(pid < 0) {
+      printf("forkbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      bench(sizes[i]);
+    wait(&status);
+    if(status != 0)
+      exit(1);
+  }
+  exit(0);
+}
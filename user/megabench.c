@@ -0,0 +1,137 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+// Megapage benchmark. A child grows its heap lazily by REGION bytes,
+// aligned to 2MB, then writes every page once (the faults) and reads
+// one word per page ROUNDS times (the scans, which miss in the TLB
+// on every page when it maps 4096-byte pages). It runs with
+// megapages off and on.
+// Then it checks that megapages are split and evicted page by page
+// when a hog leaves only FRAMES pages free, and that no data is lost.
+
+#define MEGA    (2 * 1024 * 1024)
+#define REGION  (8 * MEGA)
+#define NPAGES  (REGION / 4096)
+#define ROUNDS  50
+#define FRAMES  64
+#define PRESSED (2 * MEGA)
+#define NPRESSED (PRESSED / 4096)
+
+// Grow the heap lazily by n bytes, starting on a 2MB boundary.
+static char *
+aligned_heap(int n)
+{
+  uint64 cur = (uint64)sbrk(0);
+  uint64 pad = ((cur + MEGA - 1) & ~(uint64)(MEGA - 1)) - cur;
+
+  if(sbrklazy(pad) == (char*)-1)
+    return (char*)-1;
+  return sbrklazy(n);
+}
+
+static void
+run(int on)
+{
+  struct vmstat st0, st1;
+  char *base;
+  int t0, t1, t2, sum = 0;
+
+  megapages(on);
+  vmstat(&st0);
+  if((base = aligned_heap(REGION)) == (char*)-1) {
+    printf("megabench: sbrk failed\n");
+    exit(1);
+  }
+  t0 = uptime();
+  for(int i = 0; i < NPAGES; i++)
+    base[i * 4096] = i;
+  t1 = uptime();
+  for(int r = 0; r < ROUNDS; r++)
+    for(int i = 0; i < NPAGES; i++)
+      sum += base[i * 4096 + (r % 64) * 64];
+  t2 = uptime();
+  vmstat(&st1);
+
+  // One tick is about 100ms under qemu.
+  printf("megabench: megapages=%d fault ticks=%d scan ticks=%d mapped=%d (sum %d)\n",
+         on, t1 - t0, t2 - t1, st1.mega.mapped - st0.mega.mapped, sum);
+  exit(0);
+}
+
+// Fill PRESSED bytes with megapages, wait for the hog, then touch
+// as much again so that they are evicted; read everything back.
+static void
+pressure(int ready, int go)
+{
+  struct vmstat st0, st1;
+  char *a, *b, c;
+
+  megapages(1);
+  vmstat(&st0);
+  if((a = aligned_heap(PRESSED)) == (char*)-1) {
+    printf("megabench: sbrk failed\n");
+    exit(1);
+  }
+  for(int i = 0; i < NPRESSED; i++)
+    a[i * 4096] = i;
+  write(ready, "x", 1);
+  read(go, &c, 1);
+
+  if((b = sbrklazy(PRESSED)) == (char*)-1) {
+    printf("megabench: sbrk failed\n");
+    exit(1);
+  }
+  for(int i = 0; i < NPRESSED; i++)
+    b[i * 4096] = ~i;
+  for(int i = 0; i < NPRESSED; i++) {
+    if(a[i * 4096] != (char)i || b[i * 4096] != (char)~i) {
+      printf("megabench: FAIL page %d lost its data\n", i);
+      exit(1);
+    }
+  }
+  vmstat(&st1);
+  printf("megabench: under pressure mapped=%d split=%d\n",
+         st1.mega.mapped - st0.mega.mapped, st1.mega.splits - st0.mega.splits);
+  if(st1.mega.mapped == st0.mega.mapped || st1.mega.splits == st0.mega.splits) {
+    printf("megabench: FAIL megapages were not split for eviction\n");
+    exit(1);
+  }
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int ready[2], go[2], hogpid, status;
+  char c;
+  int old = megapages(-1);
+
+  for(int on = 0; on <= 1; on++) {
+    if(fork() == 0)
+      run(on);
+    wait(0);
+  }
+
+  if(pipe(ready) < 0 || pipe(go) < 0) {
+    printf("megabench: pipe failed\n");
+    exit(1);
+  }
+  if(fork() == 0)
+    pressure(ready[1], go[0]);
+  read(ready[0], &c, 1);
+  hogpid = fork();
+  if(hogpid == 0)
+    memhog(FRAMES);
+  pause(20);
+  write(go[1], "x", 1);
+  wait(&status);
+  kill(hogpid);
+  wait(0);
+  megapages(old);
+
+  if(status == 0)
+    printf("megabench: ok\n");
+  exit(status);
+}
@@ -0,0 +1,88 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memstat.h"
+#include "kernel/vm.h"
+#include "user/user.h"
+
+// Compare page replacement algorithms (based on test_fifo).
+// A hog child pins all but about FRAMES free physical pages, then
+// each access pattern runs over NPAGES lazily allocated pages under
+// FIFO and under CLOCK. The number of pages faulted in is read from
+// memstat's next_fifo_seq and handed back as the child's exit status.
+
+#define FRAMES    24
+#define NPAGES    48
+#define ACCESSES  2000
+
+static unsigned int seed = 1;
+
+static int
+rnd(int n)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) % n;
+}
+
+static int
+next_page(int pattern, int i)
+{
+  if(pattern == 0)                  // looping
+    return i % NPAGES;
+  if(pattern == 1)                  // random
+    return rnd(NPAGES);
+  if(rnd(10) < 8)                   // hot/cold: 80% to the hot quarter
+    return rnd(NPAGES / 4);
+  return NPAGES / 4 + rnd(NPAGES - NPAGES / 4);
+}
+
+static void
+run(int pattern, int algo)
+{
+  struct proc_mem_stat st;
+  char *base;
+  int start;
+
+  pagealgo(algo);
+  seed = 1;
+  base = sbrklazy(NPAGES * 4096);
+  if(base == (char*)-1) {
+    printf("pagebench: sbrk failed\n");
+    exit(1);
+  }
+  memstat(&st);
+  start = st.next_fifo_seq;
+  for(int i = 0; i < ACCESSES; i++)
+    base[next_page(pattern, i) * 4096] += 1;
+  memstat(&st);
+  exit(st.next_fifo_seq - start);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *patterns[] = { "looping", "random", "hot/cold" };
+  int hogpid;
+
+  printf("=== PAGE REPLACEMENT BENCHMARK ===\n");
+  printf("%d pages, about %d free frames, %d accesses\n", NPAGES, FRAMES, ACCESSES);
+
+  hogpid = fork();
+  if(hogpid == 0)
+    memhog(FRAMES);
+  pause(20);
+
+  for(int pat = 0; pat < 3; pat++) {
+    int faults[2];
+    for(int algo = PAGEALGO_FIFO; algo <= PAGEALGO_CLOCK; algo++) {
+      if(fork() == 0)
+        run(pat, algo);
+      wait(&faults[algo]);
+    }
+    printf("%s: FIFO faults=%d CLOCK faults=%d\n",
+           patterns[pat], faults[PAGEALGO_FIFO], faults[PAGEALGO_CLOCK]);
+  }
+
+  kill(hogpid);
+  wait(0);
+  exit(0);
+}
@@ -0,0 +1,95 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+// Print paging counters and fault latency histograms.
+//   pgstat          system-wide, since boot, and the compressed
+//                   swap pool
+//   pgstat pid      of process pid
+
+static char *causes[NPF] = {
+[PF_SWAP]  "swap",
+[PF_EXEC]  "exec",
+[PF_HEAP]  "heap",
+[PF_STACK] "stack",
+[PF_MMAP]  "mmap",
+[PF_MINOR] "minor",
+};
+
+static char *lats[NLAT] = {
+[LAT_FAULT]   "page fault",
+[LAT_SWAPIN]  "swap-in",
+[LAT_SWAPOUT] "swap-out",
+};
+
+// Print the non-empty buckets of a histogram, each with the upper
+// end of its range in microseconds.
+static void
+histogram(char *name, uint *lat)
+{
+  uint64 n = 0;
+
+  for(int b = 0; b < LATBUCKETS; b++)
+    n += lat[b];
+  printf("%s latency, %lu samples:\n", name, n);
+  for(int b = 0; b < LATBUCKETS; b++) {
+    if(lat[b] == 0)
+      continue;
+    if(b == LATBUCKETS - 1)
+      printf("  >= %lu us: %d\n", (1UL << b) * 1000000 / LATHZ, lat[b]);
+    else
+      printf("  <  %lu us: %d\n", (2UL << b) * 1000000 / LATHZ, lat[b]);
+  }
+}
+
+// Print the compressed swap pool's size, compression ratio, hit
+// rate and CPU cost.
+static void
+zswapstat(void)
+{
+  struct vmstat st;
+  int reads;
+
+  vmstat(&st);
+  reads = st.zswap.hits + st.zswap.misses;
+  printf("zswap: %d pages hold %d swapped pages in %d KB", st.zswap.pages,
+         st.zswap.stored, st.zswap.bytes / 1024);
+  if(st.zswap.bytes)
+    printf(" (ratio %d.%d)", st.zswap.stored * 4096 / st.zswap.bytes,
+           st.zswap.stored * 40960 / st.zswap.bytes % 10);
+  printf("\n");
+  printf("zswap: hits=%d misses=%d (%d%%) rejects=%d writebacks=%d compress=%d us decompress=%d us\n",
+         st.zswap.hits, st.zswap.misses, reads ? st.zswap.hits * 100 / reads : 0,
+         st.zswap.rejects, st.zswap.writebacks, st.zswap.comp_us, st.zswap.decomp_us);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct pagingstat st;
+  int pid = 0;
+
+  if(argc == 2)
+    pid = atoi(argv[1]);
+  else if(argc != 1) {
+    fprintf(2, "usage: pgstat [pid]\n");
+    exit(1);
+  }
+  if(pagingstat(pid, &st) < 0) {
+    fprintf(2, "pgstat: no process %d\n", pid);
+    exit(1);
+  }
+
+  printf("faults:");
+  for(int i = 0; i < NPF; i++)
+    printf(" %s=%lu", causes[i], st.faults[i]);
+  printf("\n");
+  printf("evicted=%lu discarded=%lu swap-out=%lu KB swap-in=%lu KB\n",
+         st.evicted, st.discarded, st.swapout_bytes / 1024, st.swapin_bytes / 1024);
+  for(int i = 0; i < NLAT; i++)
+    histogram(lats[i], st.lat[i]);
+  if(pid == 0)
+    zswapstat();
+  exit(0);
+}
@@ -1,17 +1,147 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/memstat.h"
+#include "kernel/param.h"
+#include "kernel/vm.h"
 #include "user/user.h"
 
-#define PAGES_PER_CHILD  500    // allocate 500 pages per child (under 1024 limit)
+#define PAGES_PER_CHILD  500    // allocate 500 pages per child
 #define CHILDREN          3
 
+// Local vs global replacement. A hog pins all but about FRAMES free
+// pages, an idle process touches IDLE_PAGES and then sleeps, and a
+// worker loops over WORK_PAGES. Under local scope the worker can only
+// recycle its own frames; under global scope it can take the idle
+// process's pages instead.
+#define FRAMES           64
+#define IDLE_PAGES       32
+#define WORK_PAGES       48
+#define WORK_ROUNDS      20
+
+// Eviction throughput. A worker dirties EVICT_PAGES pages EVICT_ROUNDS
+// times under the same hog, writing one page per disk request and
+// then SWAPCLUSTER pages per request.
+#define EVICT_PAGES     256
+#define EVICT_ROUNDS      2
+
 static void dirty_pages(char *base, int npages) {
   for (int i = 0; i < npages; i++) {
     base[i * 4096] = (char)(i & 0xFF);
   }
 }
 
+static void
+idle(void)
+{
+  char *base = sbrklazy(IDLE_PAGES * 4096);
+  if (base == (char*)-1) {
+    printf("swapstress idle: sbrk failed\n");
+    exit(1);
+  }
+  dirty_pages(base, IDLE_PAGES);
+  for (;;)
+    pause(100);
+}
+
+// Exit status is the number of pages the worker faulted in.
+static void
+work(void)
+{
+  struct proc_mem_stat st;
+  int start;
+
+  char *base = sbrklazy(WORK_PAGES * 4096);
+  if (base == (char*)-1) {
+    printf("swapstress worker: sbrk failed\n");
+    exit(1);
+  }
+  memstat(&st);
+  start = st.next_fifo_seq;
+  for (int r = 0; r < WORK_ROUNDS; r++)
+    dirty_pages(base, WORK_PAGES);
+  memstat(&st);
+  exit(st.next_fifo_seq - start);
+}
+
+static void
+compare_scopes(void)
+{
+  char *names[] = { "local", "global" };
+  int oldscope = pagescope(-1);
+
+  printf("swapstress: %d worker pages, %d idle pages, about %d free frames\n",
+         WORK_PAGES, IDLE_PAGES, FRAMES);
+
+  for (int scope = PAGESCOPE_LOCAL; scope <= PAGESCOPE_GLOBAL; scope++) {
+    int hogpid, idlepid, faults, t0, ticks;
+
+    hogpid = fork();
+    if (hogpid == 0)
+      memhog(FRAMES);
+    pause(20);
+    idlepid = fork();
+    if (idlepid == 0)
+      idle();
+    pause(10);
+
+    pagescope(scope);
+    t0 = uptime();
+    if (fork() == 0)
+      work();
+    wait(&faults);
+    ticks = uptime() - t0;
+    printf("scope=%s ticks=%d faults=%d\n", names[scope], ticks, faults);
+
+    kill(idlepid);
+    kill(hogpid);
+    wait(0);
+    wait(0);
+  }
+  pagescope(oldscope);
+}
+
+static void
+compare_clusters(void)
+{
+  struct vmstat st0, st1;
+  int sizes[] = { 1, SWAPCLUSTER };
+  int old = swapcluster(0);
+
+  for (int i = 0; i < 2; i++) {
+    int hogpid, t0, ticks, evicted;
+
+    hogpid = fork();
+    if (hogpid == 0)
+      memhog(FRAMES);
+    pause(20);
+
+    swapcluster(sizes[i]);
+    vmstat(&st0);
+    t0 = uptime();
+    if (fork() == 0) {
+      char *base = sbrklazy(EVICT_PAGES * 4096);
+      if (base == (char*)-1) {
+        printf("swapstress worker: sbrk failed\n");
+        exit(1);
+      }
+      for (int r = 0; r < EVICT_ROUNDS; r++)
+        dirty_pages(base, EVICT_PAGES);
+      exit(0);
+    }
+    wait(0);
+    ticks = uptime() - t0;
+    vmstat(&st1);
+    evicted = (st1.pageout.direct - st0.pageout.direct) +
+              (st1.pageout.evicted - st0.pageout.evicted);
+    printf("cluster=%d ticks=%d evictions=%d evictions/tick=%d\n",
+           sizes[i], ticks, evicted, ticks ? evicted / ticks : evicted);
+
+    kill(hogpid);
+    wait(0);
+  }
+  swapcluster(old);
+}
+
 int
 main(void)
 {
@@ -55,6 +185,9 @@ main(void)
   for (int c = 0; c < CHILDREN; c++) {
     wait(0);
   }
+
+  compare_scopes();
+  compare_clusters();
   printf("swapstress: done\n");
      exit(0);
 }
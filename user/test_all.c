@@ -19,9 +19,11 @@ main(int argc, char *argv[])
   printf("  5. Dirty page tracking\n");
   printf("  6. Swap capacity limits\n");
   printf("  7. Fork and swap isolation\n");
+  printf("  8. Swap inheritance across fork\n");
   printf("\n");
-  printf("Note: Check kernel console logs for detailed operation logs\n");
-  printf("      (PAGEFAULT, ALLOC, RESIDENT, MEMFULL, VICTIM, etc.)\n");
+  printf("Note: Paging events are printed on the console while the\n");
+  printf("      tests run (PAGEFAULT, ALLOC, RESIDENT, MEMFULL, VICTIM,\n");
+  printf("      etc.); tracedump shows the most recent ones afterwards.\n");
   printf("\n");
   
   char *tests[] = {
@@ -32,11 +34,13 @@ main(int argc, char *argv[])
     "test_dirty",
     "test_swapfull",
     "test_fork",
+    "test_swapfork",
     0
   };
   
   int total = 0;
   int passed = 0;
+  int oldcons = tracecons(1);
   
   for(int i = 0; tests[i] != 0; i++) {
     total++;
@@ -72,6 +76,7 @@ main(int argc, char *argv[])
     
     printf("\n");
   }
+  tracecons(oldcons);
   
   printf("========================================\n");
   printf("  TEST SUMMARY\n");
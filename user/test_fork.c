@@ -13,7 +13,8 @@ main(int argc, char *argv[])
   
   // Parent allocates some memory
   printf("\n--- Test 7a: Parent allocates memory ---\n");
-  printf("Parent PID: %d\n", getpid());
+  int parent_pid = getpid();
+  printf("Parent PID: %d\n", parent_pid);
   
   char *parent_pages[50];
   for(int i = 0; i < 50; i++) {
@@ -39,8 +40,8 @@ main(int argc, char *argv[])
     int child_pid = getpid();
     printf("\nChild PID: %d\n", child_pid);
     
-    // Child should have its own swap file
-    printf("Child should have swap file: /pgswp%05d\n", child_pid);
+    // Child shares the parent's swap slots
+    printf("Child shares swap slots of parent %d\n", parent_pid);
     
     // Check child's initial state (copy of parent)
     memstat(&info);
@@ -142,8 +143,8 @@ main(int argc, char *argv[])
     }
     
     printf("\n✓ Per-process swap isolation verified\n");
-    printf("  Each process has its own swap file\n");
-    printf("  Child's swap cleaned up on exit\n");
+    printf("  Child shares the parent's swap slots, not its pages\n");
+    printf("  Child's swap slots released on exit\n");
     printf("  Parent unaffected by child's memory operations\n");
   }
   
@@ -65,6 +65,38 @@ main(int argc, char *argv[])
     exit(1);
   }
   
+  // Read-scan a sparse lazy array: every page should map the
+  // shared zero page, so resident pages must not grow.
+  printf("\nRead-scanning 64 untouched lazy pages...\n");
+  char *sparse = sbrklazy(64 * 4096);
+  if(sparse == (char*)-1) {
+    printf("FAIL: sbrklazy failed\n");
+    exit(1);
+  }
+  memstat(&info);
+  int before = info.num_resident_pages;
+  int sum = 0;
+  for(int i = 0; i < 64; i++)
+    sum += sparse[i * 4096];
+  memstat(&info);
+  printf("After read scan: resident=%d zero=%d sum=%d\n",
+         info.num_resident_pages, info.num_zero_pages, sum);
+  if(sum != 0 || info.num_resident_pages > before + 2 || info.num_zero_pages < 64) {
+    printf("FAIL: reads of untouched pages allocated frames\n");
+    exit(1);
+  }
+
+  // The first write gives the page a frame of its own.
+  int zero = info.num_zero_pages;
+  sparse[10 * 4096] = 'D';
+  memstat(&info);
+  printf("After writing page 10: resident=%d zero=%d\n",
+         info.num_resident_pages, info.num_zero_pages);
+  if(sparse[10 * 4096] != 'D' || sparse[11 * 4096] != 0 || info.num_zero_pages != zero - 1) {
+    printf("FAIL: write to a zero page\n");
+    exit(1);
+  }
+  
   printf("PASS: Lazy allocation working correctly\n");
   exit(0);
 }
@@ -0,0 +1,130 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memstat.h"
+#include "kernel/vm.h"
+#include "user/user.h"
+
+// madvise() test. WILLNEED should fault a lazy range in so that
+// touching it faults no more; DONTNEED should forget pages, which
+// then read as zeros. Under memory pressure (a hog pins all but
+// about FRAMES pages), RANDOM should turn readahead off and
+// SEQUENTIAL on, and DONTNEED should give back swap slots.
+
+#define NPAGES   32
+#define FRAMES   48
+#define SWPAGES  128
+
+static int failed = 0;
+
+static void
+check(int ok, char *what)
+{
+  if(!ok) {
+    printf("FAIL: %s\n", what);
+    failed = 1;
+  }
+}
+
+static void
+test_willneed_dontneed(void)
+{
+  struct proc_mem_stat st0, st1, st2;
+  char *base = sbrklazy(NPAGES * 4096);
+
+  if(base == (char*)-1) {
+    printf("test_madvise: sbrk failed\n");
+    exit(1);
+  }
+  memstat(&st0);
+  check(madvise(base, NPAGES * 4096, MADV_WILLNEED) == 0, "WILLNEED failed");
+  memstat(&st1);
+  for(int i = 0; i < NPAGES; i++)
+    base[i * 4096] = i + 1;
+  memstat(&st2);
+  printf("WILLNEED: faulted in %d pages, %d more on touch\n",
+         st1.next_fifo_seq - st0.next_fifo_seq, st2.next_fifo_seq - st1.next_fifo_seq);
+  check(st1.next_fifo_seq - st0.next_fifo_seq >= NPAGES, "WILLNEED left pages out");
+  check(st2.next_fifo_seq == st1.next_fifo_seq, "pages faulted after WILLNEED");
+
+  check(madvise(base, NPAGES * 4096, MADV_DONTNEED) == 0, "DONTNEED failed");
+  memstat(&st1);
+  printf("DONTNEED: tracked pages %d -> %d\n", st2.num_pages_total, st1.num_pages_total);
+  check(st2.num_pages_total - st1.num_pages_total == NPAGES, "DONTNEED kept pages");
+  for(int i = 0; i < NPAGES; i++)
+    check(base[i * 4096] == 0, "page not zero after DONTNEED");
+
+  check(madvise(base + 1, 4096, MADV_DONTNEED) < 0, "unaligned address accepted");
+  check(madvise(base, (NPAGES + 1) * 4096, MADV_DONTNEED) < 0, "range past sbrk accepted");
+  check(madvise(base, 4096, 99) < 0, "bad advice accepted");
+}
+
+// Scan all pages once and return the pages read ahead meanwhile.
+static int
+scan(char *base)
+{
+  struct vmstat st0, st1;
+
+  vmstat(&st0);
+  for(int i = 0; i < SWPAGES; i++) {
+    if(base[i * 4096] != (char)i) {
+      printf("test_madvise: page %d corrupted\n", i);
+      exit(1);
+    }
+  }
+  vmstat(&st1);
+  return st1.ra.readahead - st0.ra.readahead;
+}
+
+static void
+worker(void)
+{
+  struct vmstat st0, st1;
+  int rnd, seq;
+  char *base = sbrklazy(SWPAGES * 4096);
+
+  if(base == (char*)-1) {
+    printf("test_madvise: sbrk failed\n");
+    exit(1);
+  }
+  for(int i = 0; i < SWPAGES; i++)
+    base[i * 4096] = (char)i;
+
+  madvise(base, SWPAGES * 4096, MADV_RANDOM);
+  rnd = scan(base);
+  madvise(base, SWPAGES * 4096, MADV_SEQUENTIAL);
+  seq = scan(base);
+
+  vmstat(&st0);
+  madvise(base, SWPAGES * 4096, MADV_DONTNEED);
+  vmstat(&st1);
+  printf("readahead: RANDOM=%d SEQUENTIAL=%d; DONTNEED freed %d swap slots\n",
+         rnd, seq, st0.swap.used - st1.swap.used);
+  exit(rnd != 0 || seq == 0 || st1.swap.used >= st0.swap.used);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int hogpid, status;
+
+  printf("=== TEST: MADVISE ===\n");
+
+  test_willneed_dontneed();
+
+  hogpid = fork();
+  if(hogpid == 0)
+    memhog(FRAMES);
+  pause(20);
+  if(fork() == 0)
+    worker();
+  wait(&status);
+  kill(hogpid);
+  wait(0);
+  check(status == 0, "hints ignored under memory pressure");
+
+  if(failed)
+    printf("FAIL: madvise test\n");
+  else
+    printf("PASS: madvise test\n");
+  exit(failed);
+}
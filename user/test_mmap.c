@@ -0,0 +1,237 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/vm.h"
+#include "user/user.h"
+
+// mmap() test. Maps a file of NPAGES pages and a bit: private
+// writes must not reach the file, shared ones must, at munmap() or
+// exit, and a child must see the parent's shared pages, even after
+// it has pushed its resident set out under a resident-set limit.
+// Then, with a hog leaving about FRAMES pages free, a shared mapping
+// larger than that is written and read back, so that its pages are
+// evicted and come back from the file.
+
+#define NPAGES  4
+#define FSIZE   (NPAGES * 4096 + 100)
+#define FRAMES  24
+#define BIGPAGES 48
+#define EVPAGES 64
+
+static char *fname = "mmapfile";
+static char buf[4096];
+static int failed = 0;
+
+static void
+check(int ok, char *what)
+{
+  if(!ok) {
+    printf("FAIL: %s\n", what);
+    failed = 1;
+  }
+}
+
+static char
+pattern(int i)
+{
+  return 'a' + i % 23;
+}
+
+static void
+makefile(char *name, int size)
+{
+  int fd = open(name, O_CREATE | O_TRUNC | O_WRONLY);
+
+  if(fd < 0) {
+    printf("test_mmap: create %s failed\n", name);
+    exit(1);
+  }
+  for(int off = 0; off < size; off += sizeof(buf)) {
+    int n = size - off < sizeof(buf) ? size - off : sizeof(buf);
+    for(int i = 0; i < n; i++)
+      buf[i] = pattern(off + i);
+    write(fd, buf, n);
+  }
+  close(fd);
+}
+
+// Byte off of the file, read with read().
+static char
+fileat(char *name, int off)
+{
+  int fd = open(name, O_RDONLY);
+  int pos = 0, n;
+  char c = 0;
+
+  while((n = read(fd, buf, sizeof(buf))) > 0) {
+    if(off < pos + n) {
+      c = buf[off - pos];
+      break;
+    }
+    pos += n;
+  }
+  close(fd);
+  return c;
+}
+
+static char*
+map(char *name, int len, int omode, int prot, int flags)
+{
+  int fd = open(name, omode);
+  char *p;
+
+  if(fd < 0) {
+    printf("test_mmap: open %s failed\n", name);
+    exit(1);
+  }
+  p = mmap(0, len, prot, flags, fd, 0);
+  close(fd);
+  return p;
+}
+
+static void
+test_private(void)
+{
+  char *p = map(fname, FSIZE, O_RDONLY, PROT_READ | PROT_WRITE, MAP_PRIVATE);
+
+  check(p != (char*)-1, "private mmap failed");
+  int ok = 1;
+  for(int i = 0; i < FSIZE; i++)
+    if(p[i] != pattern(i))
+      ok = 0;
+  check(ok, "mapped contents differ from file");
+  check(p[FSIZE] == 0, "page tail past end of file not zero");
+  p[0] = 'X';
+  p[2 * 4096] = 'X';
+  check(munmap(p, FSIZE) == 0, "munmap failed");
+  check(fileat(fname, 0) == pattern(0), "private write reached the file");
+}
+
+static void
+test_shared(void)
+{
+  char *p = map(fname, FSIZE, O_RDWR, PROT_READ | PROT_WRITE, MAP_SHARED);
+
+  check(p != (char*)-1, "shared mmap failed");
+  check(map(fname, FSIZE, O_RDONLY, PROT_READ | PROT_WRITE, MAP_SHARED) == (char*)-1,
+        "writable shared mapping of read-only file allowed");
+  p[1] = 'Y';
+  p[4096 + 1] = 'Y';
+  // Unmap the first page on its own, then the rest.
+  check(munmap(p + 4096, 4096) < 0, "hole in a mapping allowed");
+  check(munmap(p, 4096) == 0, "munmap of first page failed");
+  check(fileat(fname, 1) == 'Y', "shared write lost at munmap");
+  check(munmap(p + 4096, FSIZE - 4096) == 0, "munmap of the rest failed");
+  check(fileat(fname, 4096 + 1) == 'Y', "shared write lost at munmap");
+}
+
+static void
+test_fork(void)
+{
+  char *p = map(fname, FSIZE, O_RDWR, PROT_READ | PROT_WRITE, MAP_SHARED);
+  int status;
+
+  check(p != (char*)-1, "shared mmap failed");
+  p[2] = 'P';
+  if(fork() == 0) {
+    if(p[2] != 'P')
+      exit(1);
+    p[3] = 'C';
+    p[3 * 4096] = 'C';
+    exit(0);
+  }
+  wait(&status);
+  check(status == 0, "child did not see the parent's write");
+  check(p[3] == 'C', "parent did not see the child's write");
+  check(fileat(fname, 3 * 4096) == 'C', "child's write not written back at exit");
+  munmap(p, FSIZE);
+}
+
+// The parent writes the shared pages; the child, limited to RSS_MIN
+// resident pages, writes EVPAGES heap pages, evicting everything it
+// can, and then writes the shared pages too. Both must still share
+// them.
+static void
+test_fork_evict(void)
+{
+  char *p = map(fname, FSIZE, O_RDWR, PROT_READ | PROT_WRITE, MAP_SHARED);
+  int status, ok = 1;
+
+  check(p != (char*)-1, "shared mmap failed");
+  for(int i = 0; i < NPAGES; i++)
+    p[i * 4096 + 4] = 'P';
+  if(fork() == 0) {
+    char *heap = sbrklazy(EVPAGES * 4096);
+    if(heap == (char*)-1 || rsslimit(RSS_MIN) < 0)
+      exit(1);
+    for(int i = 0; i < EVPAGES; i++)
+      heap[i * 4096] = i;
+    for(int i = 0; i < NPAGES; i++) {
+      if(p[i * 4096 + 4] != 'P')
+        exit(1);
+      p[i * 4096 + 5] = 'C';
+    }
+    exit(0);
+  }
+  wait(&status);
+  check(status == 0, "child lost the parent's write after evicting");
+  for(int i = 0; i < NPAGES; i++)
+    if(p[i * 4096 + 4] != 'P' || p[i * 4096 + 5] != 'C')
+      ok = 0;
+  check(ok, "parent did not see the child's write after it evicted");
+  munmap(p, FSIZE);
+  check(fileat(fname, 4096 + 4) == 'P' && fileat(fname, 4096 + 5) == 'C',
+        "shared writes lost after eviction");
+}
+
+static void
+test_evict(void)
+{
+  int hogpid, status;
+  char *big = "mmapbig";
+
+  makefile(big, BIGPAGES * 4096);
+  hogpid = fork();
+  if(hogpid == 0)
+    memhog(FRAMES);
+  pause(20);
+
+  if(fork() == 0) {
+    char *p = map(big, BIGPAGES * 4096, O_RDWR, PROT_READ | PROT_WRITE, MAP_SHARED);
+    if(p == (char*)-1)
+      exit(1);
+    for(int i = 0; i < BIGPAGES; i++)
+      p[i * 4096] = 'A' + i % 26;
+    for(int i = 0; i < BIGPAGES; i++)
+      if(p[i * 4096] != 'A' + i % 26 || p[i * 4096 + 1] != pattern(i * 4096 + 1))
+        exit(1);
+    exit(0);
+  }
+  wait(&status);
+  kill(hogpid);
+  wait(0);
+  check(status == 0, "mapped page lost its data under memory pressure");
+  for(int i = 0; i < BIGPAGES; i += 7)
+    check(fileat(big, i * 4096) == 'A' + i % 26, "write lost after eviction");
+  unlink(big);
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf("=== TEST: MMAP ===\n");
+
+  makefile(fname, FSIZE);
+  test_private();
+  test_shared();
+  test_fork();
+  test_fork_evict();
+  test_evict();
+  unlink(fname);
+
+  if(failed)
+    printf("FAIL: mmap test\n");
+  else
+    printf("PASS: mmap test\n");
+  exit(failed);
+}
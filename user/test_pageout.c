@@ -0,0 +1,151 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memstat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+// Page-out daemon test. A hog pins all but about FRAMES free pages,
+// then a worker loops over NPAGES dirty pages, once with the daemon
+// disabled and once with its default watermarks. With the daemon on,
+// most evictions should move from the faulting worker (direct) to
+// the daemon. Meanwhile a copier read()s a file into COPYPAGES heap
+// pages over and over: the daemon must not take a page from under
+// a copyout() that was preempted.
+
+#define FRAMES    48
+#define NPAGES    64
+#define ROUNDS    10
+#define COPYPAGES 32
+
+static char *fname = "pageoutfile";
+
+static void
+worker(void)
+{
+  char *base = sbrklazy(NPAGES * 4096);
+  if(base == (char*)-1) {
+    printf("test_pageout: sbrk failed\n");
+    exit(1);
+  }
+  for(int r = 0; r < ROUNDS; r++)
+    for(int i = 0; i < NPAGES; i++)
+      base[i * 4096] = (char)(r + i);
+  for(int i = 0; i < NPAGES; i++) {
+    if(base[i * 4096] != (char)(ROUNDS - 1 + i)) {
+      printf("test_pageout: page %d corrupted\n", i);
+      exit(1);
+    }
+  }
+  exit(0);
+}
+
+// Byte off of the copier's file.
+static char
+pattern(int off)
+{
+  return off / 512;
+}
+
+static void
+makefile(void)
+{
+  static char buf[512];
+  int fd = open(fname, O_CREATE | O_TRUNC | O_WRONLY);
+
+  if(fd < 0) {
+    printf("test_pageout: create %s failed\n", fname);
+    exit(1);
+  }
+  for(int off = 0; off < COPYPAGES * 4096; off += sizeof(buf)) {
+    memset(buf, pattern(off), sizeof(buf));
+    write(fd, buf, sizeof(buf));
+  }
+  close(fd);
+}
+
+static void
+copier(void)
+{
+  char *base = sbrklazy(COPYPAGES * 4096);
+  int fd;
+
+  if(base == (char*)-1) {
+    printf("test_pageout: sbrk failed\n");
+    exit(1);
+  }
+  for(int r = 0; r < ROUNDS; r++) {
+    if((fd = open(fname, O_RDONLY)) < 0)
+      exit(1);
+    for(int i = 0; i < COPYPAGES; i++)
+      if(read(fd, base + i * 4096, 4096) != 4096)
+        exit(1);
+    close(fd);
+    for(int off = 0; off < COPYPAGES * 4096; off += 256) {
+      if(base[off] != pattern(off)) {
+        printf("test_pageout: read() data lost at %d\n", off);
+        exit(1);
+      }
+    }
+  }
+  exit(0);
+}
+
+static int
+run(int low, int high)
+{
+  struct vmstat st0, st1;
+  int hogpid, status, cstatus, t0;
+
+  pagewmark(low, high);
+  hogpid = fork();
+  if(hogpid == 0)
+    memhog(FRAMES);
+  pause(20);
+
+  vmstat(&st0);
+  t0 = uptime();
+  if(fork() == 0)
+    worker();
+  if(fork() == 0)
+    copier();
+  wait(&status);
+  wait(&cstatus);
+  vmstat(&st1);
+
+  printf("low=%d high=%d: ticks=%d direct=%d daemon=%d wakeups=%d stalled=%d\n",
+         low, high, uptime() - t0, st1.pageout.direct - st0.pageout.direct,
+         st1.pageout.evicted - st0.pageout.evicted,
+         st1.pageout.wakeups - st0.pageout.wakeups,
+         st1.pageout.stalled - st0.pageout.stalled);
+
+  kill(hogpid);
+  wait(0);
+  return status != 0 || cstatus != 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct vmstat st;
+  int failed = 0;
+
+  printf("=== TEST: PAGE-OUT DAEMON ===\n");
+  vmstat(&st);
+  printf("free=%d low=%d high=%d\n", st.free_pages, st.pageout.low, st.pageout.high);
+
+  if(pagewmark(8, 4) != -1) {
+    printf("FAIL: high below low accepted\n");
+    failed = 1;
+  }
+  makefile();
+  failed |= run(0, 0);
+  failed |= run(st.pageout.low, st.pageout.high);
+  pagewmark(st.pageout.low, st.pageout.high);
+  unlink(fname);
+
+  if(failed)
+    printf("FAIL: page-out daemon test\n");
+  else
+    printf("PASS: page-out daemon test\n");
+  exit(failed);
+}
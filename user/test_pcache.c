@@ -0,0 +1,93 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+// Shared executable page cache test. Runs a program RUNS times, one
+// after the other and then all at once: after the first run its text
+// should come from the page cache, not from the file, and the
+// concurrent copies should map the same frames.
+
+#define RUNS 4
+
+static char *prog[] = { "wc", "README", 0 };
+
+// Start prog with its output on a pipe that the parent drains.
+static int
+start(int *fd)
+{
+  int fds[2], pid;
+
+  if(pipe(fds) < 0) {
+    printf("test_pcache: pipe failed\n");
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0) {
+    printf("test_pcache: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0) {
+    close(1);
+    dup(fds[1]);
+    close(fds[0]);
+    close(fds[1]);
+    exec(prog[0], prog);
+    exit(1);
+  }
+  close(fds[1]);
+  *fd = fds[0];
+  return pid;
+}
+
+static int
+finish(int fd)
+{
+  char buf[64];
+  int status;
+
+  while(read(fd, buf, sizeof(buf)) > 0)
+    ;
+  close(fd);
+  wait(&status);
+  return status;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct vmstat st0, st1, st2;
+  int fds[RUNS];
+  int failed = 0;
+
+  printf("=== TEST: SHARED EXECUTABLE PAGE CACHE ===\n");
+
+  vmstat(&st0);
+  for(int i = 0; i < RUNS; i++) {
+    start(&fds[0]);
+    failed |= finish(fds[0]);
+  }
+  vmstat(&st1);
+  printf("sequential: hits=%d cached=%d\n",
+         st1.pcache.hits - st0.pcache.hits, st1.pcache.pages);
+
+  for(int i = 0; i < RUNS; i++)
+    start(&fds[i]);
+  for(int i = 0; i < RUNS; i++)
+    failed |= finish(fds[i]);
+  vmstat(&st2);
+  printf("concurrent: hits=%d cached=%d\n",
+         st2.pcache.hits - st1.pcache.hits, st2.pcache.pages);
+
+  if(st1.pcache.hits - st0.pcache.hits < RUNS - 1 ||
+     st2.pcache.hits - st1.pcache.hits < RUNS) {
+    printf("FAIL: text pages not shared\n");
+    failed = 1;
+  }
+
+  if(failed)
+    printf("FAIL: page cache test\n");
+  else
+    printf("PASS: page cache test\n");
+  exit(failed);
+}
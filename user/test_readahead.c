@@ -0,0 +1,77 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+// Swap-in readahead test. A hog pins all but about FRAMES free
+// pages, then a worker writes NPAGES pages, so that most of them are
+// swapped out to consecutive slots in VA order, and scans them
+// sequentially ROUNDS times. Pages read ahead should mostly be hits,
+// and every page must still hold what was written.
+
+#define FRAMES   48
+#define NPAGES   128
+#define ROUNDS   2
+
+static void
+worker(void)
+{
+  char *base = sbrklazy(NPAGES * 4096);
+  if(base == (char*)-1) {
+    printf("test_readahead: sbrk failed\n");
+    exit(1);
+  }
+  for(int i = 0; i < NPAGES; i++)
+    base[i * 4096] = (char)i;
+  for(int r = 0; r < ROUNDS; r++) {
+    for(int i = 0; i < NPAGES; i++) {
+      if(base[i * 4096] != (char)i) {
+        printf("test_readahead: page %d corrupted\n", i);
+        exit(1);
+      }
+    }
+  }
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct vmstat st0, st1;
+  int hogpid, status, t0, ra, hits, waste;
+  int failed = 0;
+
+  printf("=== TEST: SWAP-IN READAHEAD ===\n");
+
+  hogpid = fork();
+  if(hogpid == 0)
+    memhog(FRAMES);
+  pause(20);
+
+  vmstat(&st0);
+  t0 = uptime();
+  if(fork() == 0)
+    worker();
+  wait(&status);
+  vmstat(&st1);
+  kill(hogpid);
+  wait(0);
+
+  ra = st1.ra.readahead - st0.ra.readahead;
+  hits = st1.ra.hits - st0.ra.hits;
+  waste = st1.ra.waste - st0.ra.waste;
+  printf("ticks=%d readahead=%d hits=%d waste=%d\n", uptime() - t0, ra, hits, waste);
+
+  if(status != 0)
+    failed = 1;
+  if(ra == 0 || hits == 0) {
+    printf("FAIL: no readahead on a sequential scan\n");
+    failed = 1;
+  }
+
+  if(failed)
+    printf("FAIL: swap-in readahead test\n");
+  else
+    printf("PASS: swap-in readahead test\n");
+  exit(failed);
+}
@@ -0,0 +1,82 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memstat.h"
+#include "kernel/vm.h"
+#include "user/user.h"
+
+// Resident-set limit test. With a limit of LIMIT pages, writing
+// NPAGES lazily allocated pages must keep the resident set within
+// the limit, by evicting the process's own pages, and lose no data.
+// Then, touching HOT pages over and over for a while should give a
+// working-set estimate of about HOT pages plus code and stack.
+
+#define LIMIT   32
+#define NPAGES  128
+#define HOT     12
+#define TICKS   20
+
+static int failed = 0;
+static struct proc_mem_stat st;
+
+static void
+check(int ok, char *what)
+{
+  if(!ok) {
+    printf("FAIL: %s\n", what);
+    failed = 1;
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct pagingstat ps0, ps1;
+  char *base;
+  int ok = 1, maxrss = 0, t0;
+
+  printf("=== TEST: RSS LIMIT ===\n");
+
+  check(rsslimit(RSS_MIN - 1) < 0, "limit below RSS_MIN accepted");
+  check(rsslimit(LIMIT) == 0, "process started with a limit");
+  check(rsslimit(-1) == LIMIT, "limit not set");
+
+  if((base = sbrklazy(NPAGES * 4096)) == (char*)-1) {
+    printf("test_rss: sbrk failed\n");
+    exit(1);
+  }
+  pagingstat(getpid(), &ps0);
+  for(int i = 0; i < NPAGES; i++) {
+    base[i * 4096] = i;
+    if(i % 16 == 0) {
+      memstat(&st);
+      if(st.rss > maxrss)
+        maxrss = st.rss;
+    }
+  }
+  for(int i = 0; i < NPAGES; i++)
+    if(base[i * 4096] != (char)i)
+      ok = 0;
+  pagingstat(getpid(), &ps1);
+  printf("limit %d: max resident %d, evicted %d\n",
+         LIMIT, maxrss, (int)(ps1.evicted - ps0.evicted));
+  check(maxrss <= LIMIT, "resident set grew past the limit");
+  check(ps1.evicted > ps0.evicted, "nothing evicted at the limit");
+  check(ok, "page lost its data at the limit");
+
+  rsslimit(0);
+  for(int i = 0; i < HOT; i++)
+    base[i * 4096] = i;
+  t0 = uptime();
+  while(uptime() - t0 < TICKS)
+    for(int i = 0; i < HOT; i++)
+      base[i * 4096]++;
+  memstat(&st);
+  printf("working set: %d pages estimated, %d resident\n", st.wss, st.rss);
+  check(st.wss >= HOT && st.wss <= HOT + 16, "working-set estimate off");
+
+  if(failed)
+    printf("FAIL: rss test\n");
+  else
+    printf("PASS: rss test\n");
+  exit(failed);
+}
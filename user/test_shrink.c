@@ -0,0 +1,112 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+// Heap shrink test. Growing the heap lazily by REGION bytes,
+// touching one page every STRIDE bytes and shrinking it back must
+// return every frame, page-table page and page_info chunk it took.
+// Then, with a hog leaving about FRAMES pages free so that the
+// touched pages go to swap, shrinking must free their swap slots.
+
+#define REGION  (6 * 1024 * 1024)
+#define STRIDE  (64 * 1024)
+#define ROUNDS  8
+#define FRAMES  24
+#define SWPAGES 96
+
+static int failed = 0;
+
+static void
+check(int ok, char *what)
+{
+  if(!ok) {
+    printf("FAIL: %s\n", what);
+    failed = 1;
+  }
+}
+
+// Grow by n bytes lazily, touch a page every stride bytes, shrink.
+static void
+cycle(int n, int stride)
+{
+  char *base = sbrklazy(n);
+
+  if(base == (char*)-1) {
+    printf("test_shrink: sbrk failed\n");
+    exit(1);
+  }
+  for(int off = 0; off < n; off += stride)
+    base[off] = 1;
+  if(sbrk(-n) == (char*)-1) {
+    printf("test_shrink: shrinking failed\n");
+    exit(1);
+  }
+}
+
+static void
+test_free(void)
+{
+  struct vmstat st0, st1;
+  int old = megapages(0);
+
+  cycle(4096, 4096);   // fault in the code and stack used below
+  vmstat(&st0);
+  for(int r = 0; r < ROUNDS; r++)
+    cycle(REGION, STRIDE);
+  vmstat(&st1);
+  megapages(old);
+  printf("free pages: %d before, %d after %d rounds\n",
+         st0.free_pages, st1.free_pages, ROUNDS);
+  check(st1.free_pages >= st0.free_pages, "shrinking leaked pages");
+}
+
+static void
+test_swap(void)
+{
+  struct vmstat st0, st1;
+  struct proc_mem_stat ms;
+  int hogpid, status;
+
+  hogpid = fork();
+  if(hogpid == 0)
+    memhog(FRAMES);
+  pause(20);
+  if(fork() == 0) {
+    char *base = sbrklazy(SWPAGES * 4096);
+    int swapped = 0;
+    if(base == (char*)-1)
+      exit(1);
+    for(int i = 0; i < SWPAGES; i++)
+      base[i * 4096] = i;
+    memstat(&ms);
+    for(int i = 0; i < MAX_PAGES_INFO; i++)
+      if(ms.pages[i].state == SWAPPED && ms.pages[i].va >= (uint64)base)
+        swapped++;
+    vmstat(&st0);
+    sbrk(-SWPAGES * 4096);
+    vmstat(&st1);
+    printf("swapped heap pages %d, swap slots freed by shrinking %d\n",
+           swapped, st0.swap.used - st1.swap.used);
+    exit(swapped == 0 || st0.swap.used - st1.swap.used < swapped);
+  }
+  wait(&status);
+  kill(hogpid);
+  wait(0);
+  check(status == 0, "shrinking kept swap slots");
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf("=== TEST: HEAP SHRINK ===\n");
+
+  test_free();
+  test_swap();
+
+  if(failed)
+    printf("FAIL: shrink test\n");
+  else
+    printf("PASS: shrink test\n");
+  exit(failed);
+}
@@ -3,7 +3,7 @@
 #include "kernel/memstat.h"
 #include "user/user.h"
 
-// Test swap file operations and dirty page tracking
+// Test swap operations and dirty page tracking
 int
 main(int argc, char *argv[])
 {
@@ -12,7 +12,7 @@ main(int argc, char *argv[])
   struct proc_mem_stat info;
   
   printf("PID: %d\n", getpid());
-  printf("Swap file should be created at /pgswp%05d\n", getpid());
+  printf("Pages go to the system swap area (see boot message)\n");
   
   // Allocate many pages to force swapping
   printf("\nAllocating 200 pages to trigger swapping...\n");
@@ -123,7 +123,7 @@ main(int argc, char *argv[])
     printf("FAIL: Data corruption detected\n");
   }
   
-  printf("\nNote: Swap file /pgswp%05d will be cleaned up on exit\n", getpid());
+  printf("\nNote: swap slots of pid %d will be freed on exit\n", getpid());
   
   exit(0);
 }
@@ -0,0 +1,78 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+// Test that a forked child can reach pages its parent had
+// swapped out before the fork, and that the two copies stay
+// separate afterwards.
+
+#define FRAMES  24
+#define NPAGES  48
+
+static int
+check(char *base, int delta, char *who)
+{
+  int errors = 0;
+
+  for(int i = 0; i < NPAGES; i++) {
+    if(base[i * 4096] != (char)(i + delta)) {
+      if(errors < 5)
+        printf("ERROR: %s page %d: expected %d, got %d\n",
+               who, i, (char)(i + delta), base[i * 4096]);
+      errors++;
+    }
+  }
+  return errors;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct proc_mem_stat info;
+  int hogpid, pid, status, errors;
+
+  printf("=== TEST 8: SWAP INHERITANCE ACROSS FORK ===\n");
+
+  hogpid = fork();
+  if(hogpid == 0)
+    memhog(FRAMES);
+  pause(20);
+
+  char *base = sbrklazy(NPAGES * 4096);
+  if(base == (char*)-1) {
+    printf("sbrk failed\n");
+    kill(hogpid);
+    wait(0);
+    exit(1);
+  }
+  for(int i = 0; i < NPAGES; i++)
+    base[i * 4096] = (char)i;
+
+  memstat(&info);
+  printf("Parent before fork: resident=%d swapped=%d\n",
+         info.num_resident_pages, info.num_swapped_pages);
+  if(info.num_swapped_pages == 0)
+    printf("WARNING: nothing swapped out, test is not meaningful\n");
+
+  pid = fork();
+  if(pid == 0) {
+    errors = check(base, 0, "child");
+    for(int i = 0; i < NPAGES; i++)
+      base[i * 4096] = (char)(i + 100);
+    errors += check(base, 100, "child");
+    exit(errors != 0);
+  }
+  wait(&status);
+
+  errors = check(base, 0, "parent");
+  kill(hogpid);
+  wait(0);
+
+  if(status == 0 && errors == 0) {
+    printf("PASS: child read inherited swapped pages, parent unaffected\n");
+    exit(0);
+  }
+  printf("FAIL: child status %d, parent errors %d\n", status, errors);
+  exit(1);
+}
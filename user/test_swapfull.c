@@ -3,14 +3,198 @@
 #include "kernel/memstat.h"
 #include "user/user.h"
 
-// Test swap capacity limits (1024 pages max)
+// Test swap capacity limits (a system-wide swap area shared by
+// all processes, page metadata that grows with each process)
+
+#define FRAMES        64    // free pages left by the hog in tests 6b and 6d
+#define SLACK         256   // pages past the free swap slots in test 6b
+#define SAMPLE        16    // pages between swap usage samples in test 6b
+#define BIG_CHILDREN  2
+#define BIG_PAGES     640   // dirty pages per child in test 6d
+#define TRACK_PAGES   1536  // lazy pages one process touches in test 6e
+
+// Dirty BIG_PAGES pages, report in on ready, wait for go, then
+// check every page. Exit status is the number of bad pages.
+static void
+big_child(int id, int ready, int go)
+{
+  char c = 0;
+  int errors = 0;
+
+  char *base = sbrklazy(BIG_PAGES * 4096);
+  if(base == (char*)-1) {
+    printf("Child %d: sbrk failed\n", id);
+    exit(1);
+  }
+  for(int i = 0; i < BIG_PAGES; i++)
+    base[i * 4096] = (char)(i + id);
+  write(ready, &c, 1);
+  read(go, &c, 1);
+  for(int i = 0; i < BIG_PAGES; i++)
+    if(base[i * 4096] != (char)(i + id))
+      errors++;
+  exit(errors);
+}
+
+// Test 6b: with memory nearly full, a child dirties SLACK more
+// pages than there are free swap slots. It must be terminated for
+// swap exhaustion once the area is full. It reports swap usage
+// every SAMPLE pages through a pipe.
+static int
+swap_exhaustion(void)
+{
+  struct vmstat st;
+  int fds[2], hogpid, status, npages, used, maxused = 0;
+
+  printf("\n--- Test 6b: Exceeding swap capacity ---\n");
+  hogpid = fork();
+  if(hogpid == 0)
+    memhog(FRAMES);
+  pause(20);
+  if(pipe(fds) < 0) {
+    printf("pipe failed\n");
+    kill(hogpid);
+    wait(0);
+    return 1;
+  }
+
+  vmstat(&st);
+  npages = st.swap.slots - st.swap.used + FRAMES + SLACK;
+  printf("Child: dirtying %d pages, %d swap slots free of %d\n",
+         npages, st.swap.slots - st.swap.used, st.swap.slots);
+  if(fork() == 0) {
+    close(fds[0]);
+    char *base = sbrklazy(npages * 4096);
+    if(base == (char*)-1)
+      exit(1);
+    for(int i = 0; i < npages; i++) {
+      base[i * 4096] = (char)i;
+      if(i % SAMPLE == 0) {
+        vmstat(&st);
+        write(fds[1], &st.swap.used, sizeof(st.swap.used));
+      }
+    }
+    exit(0);
+  }
+  close(fds[1]);
+  while(read(fds[0], &used, sizeof(used)) == sizeof(used))
+    if(used > maxused)
+      maxused = used;
+  close(fds[0]);
+  wait(&status);
+  kill(hogpid);
+  wait(0);
+
+  printf("Child exited with %d, swap slots in use peaked at %d of %d\n",
+         status, maxused, st.swap.slots);
+  if(status != -1) {
+    printf("FAIL: child was not terminated when swap ran out\n");
+    return 1;
+  }
+  if(maxused < st.swap.slots - 2 * SAMPLE) {
+    printf("FAIL: child was terminated before swap was full\n");
+    return 1;
+  }
+  printf("✓ Child terminated for swap exhaustion\n");
+  return 0;
+}
+
+// Test 6d: keep more than 1024 pages in swap at once.
+static int
+beyond_1024(void)
+{
+  struct vmstat st;
+  int ready[2], go[2], hogpid, status, failed = 0;
+  char c = 0;
+
+  printf("\n--- Test 6d: More than 1024 swap slots in use ---\n");
+  if(pipe(ready) < 0 || pipe(go) < 0) {
+    printf("pipe failed\n");
+    return 1;
+  }
+
+  hogpid = fork();
+  if(hogpid == 0)
+    memhog(FRAMES);
+  pause(20);
+
+  for(int i = 0; i < BIG_CHILDREN; i++) {
+    if(fork() == 0)
+      big_child(i, ready[1], go[0]);
+  }
+  for(int i = 0; i < BIG_CHILDREN; i++)
+    read(ready[0], &c, 1);
+
+  vmstat(&st);
+  printf("Swap slots in use: %d of %d\n", st.swap.used, st.swap.slots);
+  if(st.swap.used <= 1024) {
+    printf("FAIL: expected more than 1024 slots in use\n");
+    failed = 1;
+  }
+
+  for(int i = 0; i < BIG_CHILDREN; i++)
+    write(go[1], &c, 1);
+  for(int i = 0; i < BIG_CHILDREN; i++) {
+    wait(&status);
+    if(status != 0) {
+      printf("FAIL: a child found %d bad pages\n", status);
+      failed = 1;
+    }
+  }
+  kill(hogpid);
+  wait(0);
+
+  close(ready[0]);
+  close(ready[1]);
+  close(go[0]);
+  close(go[1]);
+  if(!failed)
+    printf("✓ %d pages swapped and read back\n", BIG_CHILDREN * BIG_PAGES);
+  return failed;
+}
+
+// Test 6e: one process tracks more pages than the old fixed
+// limit of 1024 page_info entries.
+static int
+beyond_tracking_limit(void)
+{
+  int status;
+
+  printf("\n--- Test 6e: More than 1024 tracked pages in one process ---\n");
+  if(fork() == 0) {
+    int errors = 0;
+    char *base = sbrklazy(TRACK_PAGES * 4096);
+    if(base == (char*)-1) {
+      printf("Child: sbrk failed\n");
+      exit(1);
+    }
+    for(int i = 0; i < TRACK_PAGES; i++)
+      base[i * 4096] = (char)i;
+    for(int i = 0; i < TRACK_PAGES; i++)
+      if(base[i * 4096] != (char)i)
+        errors++;
+    exit(errors);
+  }
+  wait(&status);
+  if(status != 0) {
+    printf("FAIL: child exited with %d\n", status);
+    return 1;
+  }
+  printf("✓ %d lazy pages tracked and read back\n", TRACK_PAGES);
+  return 0;
+}
+
 int
 main(int argc, char *argv[])
 {
   printf("=== TEST 6: SWAP CAPACITY LIMITS ===\n");
-  printf("Max swap capacity: 1024 pages (4 MB)\n");
   
   struct proc_mem_stat info;
+  struct vmstat st;
+  int failed = 0;
+
+  vmstat(&st);
+  printf("Swap area: %d pages\n", st.swap.slots);
   
   // Test 1: Allocate well within swap limits
   printf("\n--- Test 6a: Within swap limits ---\n");
@@ -50,59 +234,7 @@ main(int argc, char *argv[])
     printf("✓ Successfully allocated within swap limits\n");
   }
   
-  // Test 2: Try to exceed swap capacity in child process
-  printf("\n--- Test 6b: Exceeding swap capacity ---\n");
-  
-  int pid = fork();
-  if(pid == 0) {
-    // Child: try to allocate more than swap can hold
-    printf("Child: Attempting to allocate 1500 pages (exceeds 1024 limit)...\n");
-    
-    char *bigpages[1500];
-    int child_allocated = 0;
-    
-    for(int i = 0; i < 1500; i++) {
-      bigpages[i] = sbrk(4096);
-      if(bigpages[i] == (char*)-1) {
-        printf("Child: sbrk failed at %d pages\n", i);
-        break;
-      }
-      child_allocated++;
-      
-      // Make every page dirty to force swap writes
-      for(int j = 0; j < 256; j++) {
-        bigpages[i][j * 16] = (char)(i & 0xFF);
-      }
-      
-      if(i % 100 == 0 && i > 0) {
-        if(memstat(&info) == 0) {
-          printf("Child progress %d: resident=%d swapped=%d\n",
-                 i, info.num_resident_pages, info.num_swapped_pages);
-        }
-      }
-      
-      // Check if we're approaching swap limit
-      if(memstat(&info) == 0 && info.num_swapped_pages > 1000) {
-        printf("Child: Swapped pages = %d (approaching 1024 limit)\n", 
-               info.num_swapped_pages);
-      }
-    }
-    
-    printf("Child: Allocated %d pages before termination\n", child_allocated);
-    exit(0);
-  } else {
-    // Parent waits for child
-    int status;
-    wait(&status);
-    
-    if(status != 0) {
-      printf("✓ Child terminated (likely due to swap exhaustion)\n");
-      printf("  This is expected when swap capacity is exceeded\n");
-    } else {
-      printf("Child completed without error\n");
-      printf("  Either swap limit wasn't reached or system has more memory\n");
-    }
-  }
+  failed |= swap_exhaustion();
   
   // Test 3: Verify parent is still okay
   printf("\n--- Test 6c: Parent process integrity ---\n");
@@ -129,7 +261,10 @@ main(int argc, char *argv[])
     printf("FAIL: Parent's data corrupted (%d errors)\n", errors);
   }
   
+  failed |= beyond_1024();
+  failed |= beyond_tracking_limit();
+
   printf("\n=== SWAP CAPACITY TEST COMPLETE ===\n");
   
-  exit(0);
+  exit(failed);
 }
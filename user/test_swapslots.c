@@ -0,0 +1,138 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/trace.h"
+#include "kernel/vm.h"
+#include "user/user.h"
+
+// Swap slot allocation test. Limited to RSS_MIN resident pages, the
+// process writes NPAGES heap pages in order, so that they are
+// evicted in order; the slots that SWAPOUT trace records report
+// for them should follow their addresses. Then every other HOLE-page
+// block is dropped with MADV_DONTNEED, freeing its slots, and
+// written again; pushed out once more by MORE new pages, those pages
+// should go back into the holes, next to their neighbours.
+
+#define NPAGES 64
+#define HOLE   8
+#define MORE   32
+#define BATCH  32
+
+static struct trace_rec recs[BATCH];
+static int slot[NPAGES + MORE];   // last swap slot of each page, -1 if none
+static char *base;
+static int failed = 0;
+
+static void
+check(int ok, char *what)
+{
+  if(!ok) {
+    printf("FAIL: %s\n", what);
+    failed = 1;
+  }
+}
+
+// Drain the trace, noting where this process's heap pages went.
+static void
+collect(void)
+{
+  int n, pid = getpid();
+
+  while((n = traceread(recs, BATCH)) > 0) {
+    for(int i = 0; i < n; i++) {
+      struct trace_rec *r = &recs[i];
+      if(r->type != TR_SWAPOUT || r->pid != pid || r->va < (uint64)base)
+        continue;
+      uint64 page = (r->va - (uint64)base) / 4096;
+      if(page < NPAGES + MORE)
+        slot[page] = r->b;
+    }
+  }
+}
+
+// Write page i. The trace is drained every few pages, before the
+// per-CPU rings wrap.
+static void
+touch(int i)
+{
+  base[i * 4096] = i;
+  if(i % 4 == 3)
+    collect();
+}
+
+// Of the neighbouring pages in [lo, hi] that are both in swap,
+// count in *pairs, return how many sit in adjacent slots.
+static int
+adjacent(int lo, int hi, int *pairs)
+{
+  int n = 0;
+
+  for(int i = lo; i < hi; i++) {
+    if(slot[i] < 0 || slot[i+1] < 0)
+      continue;
+    (*pairs)++;
+    if(slot[i+1] == slot[i] + 1)
+      n++;
+  }
+  return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int oldmega = megapages(0);
+  int adj, pairs = 0, ok = 1;
+
+  printf("=== TEST: SWAP SLOT ALLOCATION ===\n");
+
+  for(int i = 0; i < NPAGES + MORE; i++)
+    slot[i] = -1;
+  if((base = sbrklazy((NPAGES + MORE) * 4096)) == (char*)-1) {
+    printf("test_swapslots: sbrk failed\n");
+    exit(1);
+  }
+  pagealgo(PAGEALGO_CLOCK);
+  rsslimit(RSS_MIN);
+  collect();
+
+  // Sequential pages should get consecutive slots.
+  for(int i = 0; i < NPAGES; i++)
+    touch(i);
+  collect();
+  adj = adjacent(0, NPAGES - 1, &pairs);
+  printf("in order: %d of %d neighbouring pairs in adjacent slots\n", adj, pairs);
+  check(pairs >= NPAGES / 2, "too few pages swapped out");
+  check(adj * 8 >= pairs * 7, "neighbouring pages scattered in swap");
+
+  // Punch holes in the run and fill them again.
+  for(int b = HOLE; b + HOLE <= NPAGES - 2 * RSS_MIN; b += 2 * HOLE) {
+    check(madvise(base + b * 4096, HOLE * 4096, MADV_DONTNEED) == 0, "madvise failed");
+    for(int i = b; i < b + HOLE; i++)
+      slot[i] = -1;
+  }
+  for(int b = HOLE; b + HOLE <= NPAGES - 2 * RSS_MIN; b += 2 * HOLE)
+    for(int i = b; i < b + HOLE; i++)
+      touch(i);
+  for(int i = NPAGES; i < NPAGES + MORE; i++)
+    touch(i);
+  collect();
+
+  pairs = 0;
+  adj = 0;
+  for(int b = HOLE; b + HOLE <= NPAGES - 2 * RSS_MIN; b += 2 * HOLE)
+    adj += adjacent(b - 1, b + HOLE, &pairs);
+  printf("holes: %d of %d neighbouring pairs in adjacent slots\n", adj, pairs);
+  check(pairs > 0, "refilled pages not swapped out");
+  check(adj * 8 >= pairs * 7, "holes not refilled next to neighbours");
+
+  for(int i = 0; i < NPAGES + MORE; i++)
+    if(base[i * 4096] != (char)i)
+      ok = 0;
+  check(ok, "page lost its data");
+  megapages(oldmega);
+
+  if(failed)
+    printf("FAIL: swap slot test\n");
+  else
+    printf("PASS: swap slot test\n");
+  exit(failed);
+}
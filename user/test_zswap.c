@@ -0,0 +1,118 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+// Compressed swap cache test. A hog leaves about FRAMES pages free;
+// a child then writes NPAGES pages, one byte in most of them (they
+// compress well) and pseudo-random bytes in every RANDEVERY-th page
+// (it doesn't), and reads them all back twice. It runs with the
+// cache off and on: with it on, most swap-ins must come from the
+// pool and the random pages must still go to disk.
+
+#define FRAMES    24
+#define NPAGES    96
+#define RANDEVERY 8
+
+static unsigned int seed;
+
+static int
+rnd(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 16;
+}
+
+static void
+fill(char *p, int i)
+{
+  if(i % RANDEVERY == 0) {
+    seed = i;
+    for(int k = 0; k < 4096; k++)
+      p[k] = rnd();
+  } else {
+    p[0] = i;
+  }
+}
+
+static int
+same(char *p, int i)
+{
+  if(i % RANDEVERY == 0) {
+    seed = i;
+    for(int k = 0; k < 4096; k++)
+      if(p[k] != (char)rnd())
+        return 0;
+    return 1;
+  }
+  return p[0] == (char)i && p[1] == 0 && p[4095] == 0;
+}
+
+static void
+run(int on)
+{
+  struct vmstat st0, st1;
+  char *base;
+  int t0, hits, misses;
+
+  zswap(on);
+  if((base = sbrklazy(NPAGES * 4096)) == (char*)-1) {
+    printf("test_zswap: sbrk failed\n");
+    exit(1);
+  }
+  vmstat(&st0);
+  t0 = uptime();
+  for(int i = 0; i < NPAGES; i++)
+    fill(base + i * 4096, i);
+  for(int r = 0; r < 2; r++) {
+    for(int i = 0; i < NPAGES; i++) {
+      if(!same(base + i * 4096, i)) {
+        printf("test_zswap: FAIL page %d lost its data\n", i);
+        exit(1);
+      }
+    }
+  }
+  vmstat(&st1);
+  hits = st1.zswap.hits - st0.zswap.hits;
+  misses = st1.zswap.misses - st0.zswap.misses;
+  printf("zswap=%d: ticks=%d pool hits=%d disk reads=%d rejects=%d",
+         on, uptime() - t0, hits, misses, st1.zswap.rejects - st0.zswap.rejects);
+  if(st1.zswap.bytes)
+    printf(" ratio=%d", st1.zswap.stored * 4096 / st1.zswap.bytes);
+  printf("\n");
+  if(on && (hits <= misses || st1.zswap.rejects == st0.zswap.rejects))
+    exit(1);
+  if(!on && hits != 0)
+    exit(1);
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int hogpid, status, failed = 0;
+  int old = zswap(-1);
+
+  printf("=== TEST: ZSWAP ===\n");
+
+  hogpid = fork();
+  if(hogpid == 0)
+    memhog(FRAMES);
+  pause(20);
+  for(int on = 0; on <= 1; on++) {
+    if(fork() == 0)
+      run(on);
+    wait(&status);
+    if(status != 0)
+      failed = 1;
+  }
+  kill(hogpid);
+  wait(0);
+  zswap(old);
+
+  if(failed)
+    printf("FAIL: zswap test\n");
+  else
+    printf("PASS: zswap test\n");
+  exit(failed);
+}
@@ -0,0 +1,79 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+// Drain the kernel's paging event trace.
+//   tracedump          print every unread record
+//   tracedump -s       only count them by type
+//   tracedump -c 0|1   turn console printing of events off or on
+
+#define BATCH 64
+
+static struct trace_rec recs[BATCH];
+
+static char *names[] = {
+[TR_PAGEFAULT]   "PAGEFAULT",
+[TR_ALLOC]       "ALLOC",
+[TR_RESIDENT]    "RESIDENT",
+[TR_LOADEXEC]    "LOADEXEC",
+[TR_FAULTAROUND] "FAULTAROUND",
+[TR_ZEROPAGE]    "ZEROPAGE",
+[TR_COW]         "COW",
+[TR_SWAPIN]      "SWAPIN",
+[TR_READAHEAD]   "READAHEAD",
+[TR_VICTIM]      "VICTIM",
+[TR_EVICT]       "EVICT",
+[TR_SWAPOUT]     "SWAPOUT",
+[TR_SWAPKEEP]    "SWAPKEEP",
+[TR_DISCARD]     "DISCARD",
+[TR_MEMFULL]     "MEMFULL",
+[TR_SWAPCLEANUP] "SWAPCLEANUP",
+[TR_MEGAPAGE]    "MEGAPAGE",
+[TR_WRITEBACK]   "WRITEBACK",
+[TR_RSSLIMIT]    "RSSLIMIT",
+};
+
+int
+main(int argc, char *argv[])
+{
+  int counts[TR_NTYPES];
+  int summary = 0, n, total = 0;
+
+  if(argc == 3 && strcmp(argv[1], "-c") == 0) {
+    printf("console tracing was %s\n", tracecons(atoi(argv[2])) ? "on" : "off");
+    exit(0);
+  }
+  if(argc == 2 && strcmp(argv[1], "-s") == 0)
+    summary = 1;
+  else if(argc != 1) {
+    fprintf(2, "usage: tracedump [-s | -c 0|1]\n");
+    exit(1);
+  }
+
+  memset(counts, 0, sizeof(counts));
+  while((n = traceread(recs, BATCH)) > 0) {
+    for(int i = 0; i < n; i++) {
+      struct trace_rec *r = &recs[i];
+      if(r->type >= TR_NTYPES)
+        continue;
+      counts[r->type]++;
+      if(!summary)
+        printf("%ld cpu%d [pid %d] %s va=0x%lx a=%d b=%d\n",
+               r->time, r->cpu, r->pid, names[r->type], r->va, r->a, r->b);
+    }
+    total += n;
+  }
+  if(n < 0) {
+    fprintf(2, "tracedump: traceread failed\n");
+    exit(1);
+  }
+
+  if(summary) {
+    for(int t = 1; t < TR_NTYPES; t++)
+      if(counts[t])
+        printf("%s %d\n", names[t], counts[t]);
+    printf("total %d\n", total);
+  }
+  exit(0);
+}
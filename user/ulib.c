@@ -159,3 +159,19 @@ sbrklazy(int n) {
   return sys_sbrk(n, SBRK_LAZY);
 }
 
+// Allocate eagerly until memory runs out, then give back frames
+// pages, and stay: pins all but about frames free physical pages
+// until killed.
+void
+memhog(int frames)
+{
+  int chunk = 256 * 4096;
+
+  while(chunk >= 4096) {
+    if(sbrk(chunk) == (char*)-1)
+      chunk /= 2;
+  }
+  sbrk(-frames * 4096);
+  for(;;)
+    pause(100);
+}
@@ -2,6 +2,9 @@
 
 struct stat;
 struct proc_mem_stat;  // Forward declaration
+struct vmstat;
+struct pagingstat;
+struct trace_rec;
 
 // system calls
 int fork(void);
@@ -26,6 +29,21 @@ char* sys_sbrk(int,int);
 int pause(int);
 int uptime(void);
 int memstat(struct proc_mem_stat*);
+int pagealgo(int);
+int pagescope(int);
+int pagewmark(int, int);
+int vmstat(struct vmstat*);
+int swapcluster(int);
+int faultaround(int);
+int traceread(struct trace_rec*, int);
+int tracecons(int);
+int megapages(int);
+int madvise(void*, int, int);
+void* mmap(void*, int, int, int, int, int);
+int munmap(void*, int);
+int pagingstat(int, struct pagingstat*);
+int rsslimit(int);
+int zswap(int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -41,6 +59,7 @@ int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
 char* sbrk(int);
 char* sbrklazy(int);
+void memhog(int) __attribute__((noreturn));
 
 // printf.c
 void fprintf(int, const char*, ...) __attribute__ ((format (printf, 2, 3)));
@@ -43,3 +43,18 @@ entry("sbrk");
 entry("pause");
 entry("uptime");
 entry("memstat");
+entry("pagealgo");
+entry("pagescope");
+entry("pagewmark");
+entry("vmstat");
+entry("swapcluster");
+entry("faultaround");
+entry("traceread");
+entry("tracecons");
+entry("megapages");
+entry("madvise");
+entry("mmap");
+entry("munmap");
+entry("pagingstat");
+entry("rsslimit");
+entry("zswap");